@@ -4,10 +4,64 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <cstring>
 #include "libAES.h"
+#include "libAES_backends.h"
+#include "libAES_threads.h"
 
 using namespace std;
 
+// number of blocks handed to encryptBlocks/decryptBlocks at a time by the modes
+static const size_t BATCH_BLOCKS = 32;
+
+// the vector overloads below copy through an aesBlock and back
+static aesBlock loadBlock(const vector<uint8_t>& block)
+{
+    aesBlock result;
+    copy(block.begin(), block.begin() + 16, result.bytes);
+    return result;
+}
+
+
+static void storeBlock(const aesBlock& block, vector<uint8_t>& out)
+{
+    copy(block.bytes, block.bytes + 16, out.begin());
+}
+
+
+// out = text ^ keystream, 16 bytes at a time; out may be text, so a byte
+// loop would not vectorize
+static void xorKeystream(const uint8_t* text, const uint8_t* keystream, uint8_t* out, size_t length)
+{
+    size_t i = 0;
+    for(; i + 16 <= length; i += 16)
+    {
+        uint64_t low, high, key_low, key_high;
+        memcpy(&low, text + i, 8);
+        memcpy(&high, text + i + 8, 8);
+        memcpy(&key_low, keystream + i, 8);
+        memcpy(&key_high, keystream + i + 8, 8);
+        low ^= key_low;
+        high ^= key_high;
+        memcpy(out + i, &low, 8);
+        memcpy(out + i + 8, &high, 8);
+    }
+    for(; i < length; i++)
+        out[i] = text[i] ^ keystream[i];
+}
+
+void libAES::setThreads(unsigned count)
+{
+    threads = count;
+}
+
+
+unsigned libAES::getThreads() const
+{
+    return threads;
+}
+
+
 void libAES::printBinaryVector(const vector<uint8_t>& binary_data) {
     for (uint8_t byte : binary_data) {
         for (int i = 7; i >= 0; --i) {
@@ -28,27 +82,34 @@ void libAES::padBinary(vector<uint8_t>& binary_data)
 }
 
 
-void libAES::unpadBinary(vector<uint8_t>& binary_data)
+// length of the data once its PKCS#7 padding is checked and dropped
+static size_t unpaddedLength(const uint8_t* data, size_t length)
 {
-    if (binary_data.empty())
+    if (length == 0)
     {
-        return;
+        return 0;
     }
 
-    int unpadValue = static_cast<int>(binary_data.back());
+    int unpadValue = static_cast<int>(data[length - 1]);
 
-    if (unpadValue == 0 || unpadValue > 16 || unpadValue > static_cast<int>(binary_data.size()))
+    if (unpadValue == 0 || unpadValue > 16 || unpadValue > static_cast<int>(length))
     {
         throw runtime_error("Invalid Padding");
     }
 
     for (int i = 0; i < unpadValue; ++i)
     {
-        if (binary_data[binary_data.size() - 1 - i] != unpadValue)
+        if (data[length - 1 - i] != unpadValue)
             throw runtime_error("Invalid Padding");
     }
 
-    binary_data.erase(binary_data.end() - unpadValue, binary_data.end());
+    return length - unpadValue;
+}
+
+
+void libAES::unpadBinary(vector<uint8_t>& binary_data)
+{
+    binary_data.resize(unpaddedLength(binary_data.data(), binary_data.size()));
 }
 
 
@@ -83,7 +144,7 @@ void libAES::binaryToFile(const vector<uint8_t>& writeVector, const string& file
 }
 
 
-void libAES::sBox(vector<uint8_t>& block)
+void libAES::sBox(aesBlock& block)
 {
     for(int i = 0; i < 16; i++)
     {
@@ -92,43 +153,55 @@ void libAES::sBox(vector<uint8_t>& block)
 }
 
 
-void libAES::shiftRows(vector<uint8_t>& block)
+void libAES::sBox(vector<uint8_t>& block)
+{
+    aesBlock temp = loadBlock(block);
+    sBox(temp);
+    storeBlock(temp, block);
+}
+
+
+void libAES::shiftRows(aesBlock& block)
 {
-    vector<uint8_t> subBlock;
+    aesBlock temp = block;
     for (int i = 1; i < 4; i++)
     {
-        subBlock = {block[i], block[i + 4], block[i + 8], block[i + 12]};
-        subBlock = rotate(subBlock, i);
-
-        block[i] = subBlock[0];
-        block[i + 4] = subBlock[1];
-        block[i + 8] = subBlock[2];
-        block[i + 12] = subBlock[3];
+        // row i moves i columns to the left
+        for (int col = 0; col < 4; col++)
+            block[i + col * 4] = temp[i + ((col + i) % 4) * 4];
     }
 }
 
 
-void libAES::mixColumns(vector<uint8_t>& block) {
-    vector<uint8_t> tempBlock = block;
-    const uint8_t mixMatrix[4][4] = {
-        {0x02, 0x03, 0x01, 0x01},
-        {0x01, 0x02, 0x03, 0x01},
-        {0x01, 0x01, 0x02, 0x03},
-        {0x03, 0x01, 0x01, 0x02}
-    };
+void libAES::shiftRows(vector<uint8_t>& block)
+{
+    aesBlock temp = loadBlock(block);
+    shiftRows(temp);
+    storeBlock(temp, block);
+}
 
-    for (int col = 0; col < 4; ++col) {
-        for (int row = 0; row < 4; ++row) {
-            block[col * 4 + row] =
-                gfMult(tempBlock[col * 4 + 0], mixMatrix[row][0]) ^
-                gfMult(tempBlock[col * 4 + 1], mixMatrix[row][1]) ^
-                gfMult(tempBlock[col * 4 + 2], mixMatrix[row][2]) ^
-                gfMult(tempBlock[col * 4 + 3], mixMatrix[row][3]);
-        }
+
+void libAES::mixColumns(aesBlock& block)
+{
+    for (int col = 0; col < 16; col += 4)
+    {
+        uint8_t a0 = block[col], a1 = block[col + 1], a2 = block[col + 2], a3 = block[col + 3];
+        block[col]     = AES_TABLES.mul2[a0] ^ AES_TABLES.mul3[a1] ^ a2 ^ a3;
+        block[col + 1] = a0 ^ AES_TABLES.mul2[a1] ^ AES_TABLES.mul3[a2] ^ a3;
+        block[col + 2] = a0 ^ a1 ^ AES_TABLES.mul2[a2] ^ AES_TABLES.mul3[a3];
+        block[col + 3] = AES_TABLES.mul3[a0] ^ a1 ^ a2 ^ AES_TABLES.mul2[a3];
     }
 }
 
 
+void libAES::mixColumns(vector<uint8_t>& block)
+{
+    aesBlock temp = loadBlock(block);
+    mixColumns(temp);
+    storeBlock(temp, block);
+}
+
+
 void libAES::addRoundKey(vector<uint8_t>& block, const vector<uint8_t>& key)
 {
     int size = block.size();
@@ -154,35 +227,22 @@ vector<uint8_t> libAES::rotate(vector<uint8_t>& subBlock, int num_rots)
 
 uint8_t libAES::gfMult(uint8_t data, uint8_t multiplier)
 {
-    uint8_t temp;
     switch (multiplier)
     {
         case 0x01:
             return data;
-
         case 0x02:
-            temp = (data << 1);
-            if (data & 0x80)
-            {
-                temp ^= 0x1b;
-            }
-            return temp & 0xFF;
-
+            return AES_TABLES.mul2[data];
         case 0x03:
-            return gfMult(data, 0x02) ^ data;
-
+            return AES_TABLES.mul3[data];
         case 0x09:
-            return gfMult(gfMult(gfMult(data, 0x02), 0x02), 0x02) ^ data;
-
+            return AES_TABLES.mul9[data];
         case 0x0b:
-            return gfMult(gfMult(gfMult(data, 0x02), 0x02), 0x02) ^ gfMult(data, 0x02) ^ data;
-
+            return AES_TABLES.mul11[data];
         case 0x0d:
-            return gfMult(gfMult(gfMult(data, 0x02), 0x02), 0x02) ^ gfMult(gfMult(data, 0x02), 0x02) ^ data;
-
+            return AES_TABLES.mul13[data];
         case 0x0e:
-            return gfMult(gfMult(gfMult(data, 0x02), 0x02), 0x02) ^ gfMult(gfMult(data, 0x02), 0x02) ^ gfMult(data, 0x02);
-
+            return AES_TABLES.mul14[data];
         default:
             return 0x00;
     }
@@ -191,14 +251,13 @@ uint8_t libAES::gfMult(uint8_t data, uint8_t multiplier)
 
 void libAES::calcRoundKey128(vector<uint8_t>& key, int round)
 {
-    uint8_t Rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
     vector<uint8_t> tail = {key[13], key[14], key[15], key[12]};
     
     for (int i = 0; i < 4; i++) {
         tail[i] = SBox_consts[tail[i]];
     }
 
-    tail[0] ^= Rcon[round - 1];
+    tail[0] ^= AES_TABLES.rcon[round - 1];
 
     for(int i = 0; i < 4; i++) {
         key[i] ^= tail[i];
@@ -212,14 +271,13 @@ void libAES::calcRoundKey128(vector<uint8_t>& key, int round)
 
 void libAES::calcRoundKey192(vector<uint8_t>& key, int round)
 {
-    uint8_t Rcon[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
     vector<uint8_t> tail = {key[21], key[22], key[23], key[20]};
 
     for (int i = 0; i < 4; i++) {
         tail[i] = SBox_consts[tail[i]];
     }
 
-    tail[0] ^= Rcon[round - 1];
+    tail[0] ^= AES_TABLES.rcon[round - 1];
 
     for(int i = 0; i < 4; i++) {
         key[i] ^= tail[i];
@@ -233,14 +291,13 @@ void libAES::calcRoundKey192(vector<uint8_t>& key, int round)
 
 void libAES::calcRoundKey256(vector<uint8_t>& key, int round)
 {
-    uint8_t Rcon[7] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40};
     vector<uint8_t> tail = {key[29], key[30], key[31], key[28]};
 
     for (int i = 0; i < 4; i++) {
         tail[i] = SBox_consts[tail[i]];
     }
 
-    tail[0] ^= Rcon[round - 1];
+    tail[0] ^= AES_TABLES.rcon[round - 1];
 
     for(int i = 0; i < 4; i++) {
         key[i] ^= tail[i];
@@ -260,197 +317,90 @@ void libAES::calcRoundKey256(vector<uint8_t>& key, int round)
 }
 
 
-void libAES::aes128(vector<uint8_t>& block, vector<uint8_t>& key)
+void libAES::aes128(vector<uint8_t>& block, const vector<uint8_t>& key)
 {
-    libAES AES;
-    AES.addRoundKey(block, key);
+    // one key expansion, the caller's key is left as it was
+    if(key.size() != 16)
+        throw runtime_error("Invalid key length.");
+    aesEncrypt(block, expandKey(key));
+}
 
-    for(int i = 1; i < 10; i++)
-    {
-        AES.sBox(block);
-        AES.shiftRows(block);
-        AES.mixColumns(block);
-        AES.calcRoundKey128(key, i);
-        AES.addRoundKey(block, key);
-    }
 
-    AES.sBox(block);
-    AES.shiftRows(block);
-    AES.calcRoundKey128(key, 10);
-    AES.addRoundKey(block, key);
+void libAES::aes192(vector<uint8_t>& block, const vector<uint8_t>& key)
+{
+    // one key expansion, the caller's key is left as it was
+    if(key.size() != 24)
+        throw runtime_error("Invalid key length.");
+    aesEncrypt(block, expandKey(key));
 }
 
 
-void libAES::aes192(vector<uint8_t>& block, vector<uint8_t>& key)
+void libAES::aes256(vector<uint8_t>& block, const vector<uint8_t>& key)
 {
-    libAES AES;
-
-    vector<uint8_t> round_key; // spliced key
-    int index; // index of calculated key
-    int key_counter = 1; // pseudo round number ofr key calculation
+    // one key expansion, the caller's key is left as it was
+    if(key.size() != 32)
+        throw runtime_error("Invalid key length.");
+    aesEncrypt(block, expandKey(key));
+}
 
-    // round 0
-    for (index = 0; index < 16; index++)
-    {
-        round_key.push_back(key[index]);
-    }
-    AES.addRoundKey(block, round_key);
-    round_key.clear();
 
-    // intermediate key splitting (rounds 1-11)
-    for(int i = 1; i < 12; i++)
-    {
-        AES.sBox(block);
-        AES.shiftRows(block);
-        AES.mixColumns(block);
 
-        if(index == 0) // generate new, use first 4 words
-        {
-            AES.calcRoundKey192(key, key_counter++);
-            for (index = 0; index < 16; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-        }
-        else if (index == 8) // use last 4 words
-        {
-            for (index = 8; index < 24; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-            index = 0;
-        }
-        else // use last 2 words, generate new, user first 2 words
-        {
-            for (index = 16; index < 24; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-            index = 0;
-            AES.calcRoundKey192(key, key_counter++);
-            for (index = 0; index < 8; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-        }
-        AES.addRoundKey(block, round_key);
-        round_key.clear();
-    }
 
-    // round 12
-    AES.sBox(block);
-    AES.shiftRows(block);
-    AES.calcRoundKey192(key, key_counter++);
-    for (index = 0; index < 16; index++)
+void libAES::sBoxInv(aesBlock& block)
+{
+    for(int i = 0; i < 16; i++)
     {
-        round_key.push_back(key[index]);
+        block[i] = SBox_constsInv[block[i]];
     }
-    AES.addRoundKey(block, round_key);
-    
 }
 
 
-void libAES::aes256(vector<uint8_t>& block, vector<uint8_t>& key)
+void libAES::sBoxInv(vector<uint8_t>& block)
 {
-    libAES AES;
-
-    vector<uint8_t> round_key; // spliced key
-    int index; // index of calculated key
-    int key_counter = 1; // pseudo round number ofr key calculation
-
-    // round 0
-    for (index = 0; index < 16; index++)
-    {
-        round_key.push_back(key[index]);
-    }
-    AES.addRoundKey(block, round_key);
-    round_key.clear();
+    aesBlock temp = loadBlock(block);
+    sBoxInv(temp);
+    storeBlock(temp, block);
+}
 
-    // intermediate key splitting (rounds 1-11)
-    for(int i = 1; i < 14; i++)
-    {
-        AES.sBox(block);
-        AES.shiftRows(block);
-        AES.mixColumns(block);
-    
-        if(index == 0) // generate new, use first 4 words
-        {
-            AES.calcRoundKey256(key, key_counter++);
-            for (index = 0; index < 16; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-        }
-        else // use last 4 words
-        {
-            for (index = 16; index < 32; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-            index = 0;
-        }
-        AES.addRoundKey(block, round_key);
-        round_key.clear();
-    }
 
-    // round 14
-    AES.sBox(block);
-    AES.shiftRows(block);
-    AES.calcRoundKey256(key, key_counter++);
-    for (index = 0; index < 16; index++)
+void libAES::shiftRowsInv(aesBlock& block)
+{
+    aesBlock temp = block;
+    for (int i = 1; i < 4; i++)
     {
-        round_key.push_back(key[index]);
+        // row i moves i columns to the right
+        for (int col = 0; col < 4; col++)
+            block[i + col * 4] = temp[i + ((col + 4 - i) % 4) * 4];
     }
-    AES.addRoundKey(block, round_key);
 }
 
 
-
-
-void libAES::sBoxInv(vector<uint8_t>& block)
+void libAES::shiftRowsInv(vector<uint8_t>& block)
 {
-    for(int i = 0; i < 16; i++)
-    {
-        block[i] = SBox_constsInv[block[i]];
-    }
+    aesBlock temp = loadBlock(block);
+    shiftRowsInv(temp);
+    storeBlock(temp, block);
 }
 
 
-void libAES::shiftRowsInv(vector<uint8_t>& block)
+void libAES::mixColumnsInv(aesBlock& block)
 {
-    vector<uint8_t> subBlock;
-    for (int i = 1; i < 4; i++)
+    for (int col = 0; col < 16; col += 4)
     {
-        subBlock = {block[i], block[i + 4], block[i + 8], block[i + 12]};
-        subBlock = rotate(subBlock, 4-i);
-
-        block[i]     = subBlock[0];
-        block[i + 4] = subBlock[1];
-        block[i + 8] = subBlock[2];
-        block[i + 12] = subBlock[3];
+        uint8_t a0 = block[col], a1 = block[col + 1], a2 = block[col + 2], a3 = block[col + 3];
+        block[col]     = AES_TABLES.mul14[a0] ^ AES_TABLES.mul11[a1] ^ AES_TABLES.mul13[a2] ^ AES_TABLES.mul9[a3];
+        block[col + 1] = AES_TABLES.mul9[a0] ^ AES_TABLES.mul14[a1] ^ AES_TABLES.mul11[a2] ^ AES_TABLES.mul13[a3];
+        block[col + 2] = AES_TABLES.mul13[a0] ^ AES_TABLES.mul9[a1] ^ AES_TABLES.mul14[a2] ^ AES_TABLES.mul11[a3];
+        block[col + 3] = AES_TABLES.mul11[a0] ^ AES_TABLES.mul13[a1] ^ AES_TABLES.mul9[a2] ^ AES_TABLES.mul14[a3];
     }
 }
 
 
 void libAES::mixColumnsInv(vector<uint8_t>& block)
 {
-    vector<uint8_t> tempBlock = block;
-    const uint8_t mixMatrix[4][4] = {
-        {0x0e, 0x0b, 0x0d, 0x09},
-        {0x09, 0x0e, 0x0b, 0x0d},
-        {0x0d, 0x09, 0x0e, 0x0b},
-        {0x0b, 0x0d, 0x09, 0x0e}
-    };
-
-    for (int col = 0; col < 4; ++col) {
-        for (int row = 0; row < 4; ++row) {
-            block[row + col * 4] = 
-                gfMult(tempBlock[col * 4 + 0], mixMatrix[row][0]) ^
-                gfMult(tempBlock[col * 4 + 1], mixMatrix[row][1]) ^
-                gfMult(tempBlock[col * 4 + 2], mixMatrix[row][2]) ^
-                gfMult(tempBlock[col * 4 + 3], mixMatrix[row][3]);
-        }
-    }
+    aesBlock temp = loadBlock(block);
+    mixColumnsInv(temp);
+    storeBlock(temp, block);
 }
 
 
@@ -472,7 +422,6 @@ vector<uint8_t> libAES::rotateInv(vector<uint8_t>& subBlock, int num_rots)
 
 void libAES::calcRoundKey128Inv(vector<uint8_t>& key, int round)
 {
-    uint8_t Rcon[10] = {0x36, 0x1B, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
     vector<uint8_t> tail;
 
     for(int i = 16; i > 3; i--) {
@@ -485,7 +434,7 @@ void libAES::calcRoundKey128Inv(vector<uint8_t>& key, int round)
         tail[i] = SBox_consts[tail[i]];
     }
 
-    tail[0] ^= Rcon[round - 1];
+    tail[0] ^= AES_TABLES.rcon[10 - round];
 
     for(int i = 3; i >= 0; i--) {
         key[i] ^= tail[i];
@@ -495,7 +444,6 @@ void libAES::calcRoundKey128Inv(vector<uint8_t>& key, int round)
 
 void libAES::calcRoundKey192Inv(vector<uint8_t>& key, int round)
 {
-    uint8_t Rcon[8] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
     vector<uint8_t> tail;
 
     for(int i = 23; i > 3; i--) {
@@ -508,7 +456,7 @@ void libAES::calcRoundKey192Inv(vector<uint8_t>& key, int round)
         tail[i] = SBox_consts[tail[i]];
     }
 
-    tail[0] ^= Rcon[round - 1];
+    tail[0] ^= AES_TABLES.rcon[8 - round];
 
     for(int i = 3; i >= 0; i--) {
         key[i] ^= tail[i];
@@ -518,7 +466,6 @@ void libAES::calcRoundKey192Inv(vector<uint8_t>& key, int round)
 
 void libAES::calcRoundKey256Inv(vector<uint8_t>& key, int round)
 {
-    uint8_t Rcon[7] = {0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
     vector<uint8_t> tail;
 
     for(int i = 31; i > 19; i--) {
@@ -539,7 +486,7 @@ void libAES::calcRoundKey256Inv(vector<uint8_t>& key, int round)
         tail[i] = SBox_consts[tail[i]];
     }
 
-    tail[0] ^= Rcon[round - 1];
+    tail[0] ^= AES_TABLES.rcon[7 - round];
 
     for(int i = 3; i >= 0; i--) {
         key[i] ^= tail[i];
@@ -547,1057 +494,1237 @@ void libAES::calcRoundKey256Inv(vector<uint8_t>& key, int round)
 }
 
 
-void libAES::aes128Inv(vector<uint8_t>& block, vector<uint8_t>& key)
+void libAES::aes128Inv(vector<uint8_t>& block, const vector<uint8_t>& key)
+{
+    // one key expansion, then the equivalent inverse cipher
+    if(key.size() != 16)
+        throw runtime_error("Invalid key length.");
+    aesDecrypt(block, expandKey(key));
+}
+
+
+void libAES::aes192Inv(vector<uint8_t>& block, const vector<uint8_t>& key)
 {
-    libAES AES;
+    // one key expansion, then the equivalent inverse cipher
+    if(key.size() != 24)
+        throw runtime_error("Invalid key length.");
+    aesDecrypt(block, expandKey(key));
+}
+
+
+void libAES::aes256Inv(vector<uint8_t>& block, const vector<uint8_t>& key)
+{
+    // one key expansion, then the equivalent inverse cipher
+    if(key.size() != 32)
+        throw runtime_error("Invalid key length.");
+    aesDecrypt(block, expandKey(key));
+}
+
 
-    for(int i = 1; i <= 10; i++)
+void libAES::addRoundKey(vector<uint8_t>& block, const uint8_t* roundKey)
+{
+    for(int i = 0; i < 16; i++)
     {
-        AES.calcRoundKey128(key, i);
+        block[i] = block[i] ^ roundKey[i];
     }
+}
 
-    AES.addRoundKey(block, key);
-    AES.calcRoundKey128Inv(key, 1);
-    AES.shiftRowsInv(block);
-    AES.sBoxInv(block);
 
-    for(int i = 2; i <= 10; i++)
+void libAES::addRoundKey(aesBlock& block, const uint8_t* roundKey)
+{
+    for(int i = 0; i < 16; i++)
     {
-        AES.addRoundKey(block, key);
-        AES.calcRoundKey128Inv(key, i);
-        AES.mixColumnsInv(block);
-        AES.shiftRowsInv(block);
-        AES.sBoxInv(block);
+        block[i] = block[i] ^ roundKey[i];
     }
-
-    AES.addRoundKey(block, key);
 }
 
 
-void libAES::aes192Inv(vector<uint8_t>& block, vector<uint8_t>& key)
+// FIPS-197 rounds on an aesBlock, the REFERENCE backend
+template<int Rounds>
+static void referenceEncrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
 {
+    aesBlock block;
+    copy(in, in + 16, block.bytes);
+    libAES::addRoundKey(block, schedule.roundKeys);
 
-    libAES AES;
-    vector<uint8_t> round_key; // spliced key
-    int index; // index of calculated key
-    int key_counter = 1; // pseudo round number ofr key calculation
-
-    for(int i = 1; i <= 8; i++) // get end key
+#pragma GCC unroll 14
+    for(int i = 1; i < Rounds; i++)
     {
-        AES.calcRoundKey192(key, i);
+        libAES::sBox(block);
+        libAES::shiftRows(block);
+        libAES::mixColumns(block);
+        libAES::addRoundKey(block, schedule.roundKeys + (i * 16));
     }
 
-    for (index = 0; index < 16; index++) // get first 4 of last roll
+    libAES::sBox(block);
+    libAES::shiftRows(block);
+    libAES::addRoundKey(block, schedule.roundKeys + (Rounds * 16));
+    copy(block.bytes, block.bytes + 16, out);
+}
+
+
+// equivalent inverse cipher, same round structure as encryption
+template<int Rounds>
+static void referenceDecrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    aesBlock block;
+    copy(in, in + 16, block.bytes);
+    libAES::addRoundKey(block, schedule.decRoundKeys);
+
+#pragma GCC unroll 14
+    for(int i = 1; i < Rounds; i++)
     {
-        round_key.push_back(key[index]);
+        libAES::sBoxInv(block);
+        libAES::shiftRowsInv(block);
+        libAES::mixColumnsInv(block);
+        libAES::addRoundKey(block, schedule.decRoundKeys + (i * 16));
     }
-    AES.addRoundKey(block, round_key);
-    index = 23; // set our index to the end
-    AES.shiftRowsInv(block);
-    AES.sBoxInv(block);
 
-    for(int i = 1; i < 12; i++)
-    {
-        round_key.clear();
+    libAES::sBoxInv(block);
+    libAES::shiftRowsInv(block);
+    libAES::addRoundKey(block, schedule.decRoundKeys + (Rounds * 16));
+    copy(block.bytes, block.bytes + 16, out);
+}
 
-        if(index == 23) // generate new, use last 4 words
-        {
-            AES.calcRoundKey192Inv(key, key_counter++);
 
-            for (index = 8; index < 24; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-            index = 7;
-        }
-        else if (index == 7) // save first 2, generate new, append first 2 to last 2
-        {
-            for (index = 0; index < 8; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-            AES.calcRoundKey192Inv(key, key_counter++);
+// multi-block entry for backends without one of their own
+static void encryptEachBlock(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    for(size_t i = 0; i < blocks; i++)
+        schedule.encryptBlock(in + (i * 16), out + (i * 16), schedule);
+}
 
-            for (index = 16; index < 24; index++)
-            {
-                round_key.insert(round_key.begin(), (key[index]));
-            }
-            uint8_t temp;
-            for(int i = 0; i < 4; i++)
+
+static void decryptEachBlock(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    for(size_t i = 0; i < blocks; i++)
+        schedule.decryptBlock(in + (i * 16), out + (i * 16), schedule);
+}
+
+
+template<int Rounds>
+static void bitsliceEncryptBlock(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    bitsliceEncryptBlocks<Rounds>(in, out, 1, schedule);
+}
+
+
+template<int Rounds>
+static void bitsliceDecryptBlock(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    bitsliceDecryptBlocks<Rounds>(in, out, 1, schedule);
+}
+
+
+template<typename Function>
+static Function byRounds(int rounds, Function rounds10, Function rounds12, Function rounds14)
+{
+    return (rounds == 10) ? rounds10 : ((rounds == 12) ? rounds12 : rounds14);
+}
+
+
+// the only backend and key size dispatch, every block after this goes
+// straight to the instantiation for the key
+static void selectBlockFunctions(aesKeySchedule& schedule)
+{
+    int rounds = schedule.rounds;
+
+    schedule.encryptBlocks = encryptEachBlock;
+    schedule.decryptBlocks = decryptEachBlock;
+
+    switch(schedule.backend)
+    {
+#ifdef LIBAES_X86
+        case AES_BACKEND_VAES:
+            schedule.encryptBlock = byRounds(rounds, aesniEncrypt<10>, aesniEncrypt<12>, aesniEncrypt<14>);
+            schedule.decryptBlock = byRounds(rounds, aesniDecrypt<10>, aesniDecrypt<12>, aesniDecrypt<14>);
+            schedule.encryptBlocks = byRounds(rounds, vaesEncryptBlocks<10>, vaesEncryptBlocks<12>, vaesEncryptBlocks<14>);
+            schedule.decryptBlocks = byRounds(rounds, vaesDecryptBlocks<10>, vaesDecryptBlocks<12>, vaesDecryptBlocks<14>);
+            break;
+        case AES_BACKEND_AESNI:
+            schedule.encryptBlock = byRounds(rounds, aesniEncrypt<10>, aesniEncrypt<12>, aesniEncrypt<14>);
+            schedule.decryptBlock = byRounds(rounds, aesniDecrypt<10>, aesniDecrypt<12>, aesniDecrypt<14>);
+            schedule.encryptBlocks = byRounds(rounds, aesniEncryptBlocks<10>, aesniEncryptBlocks<12>, aesniEncryptBlocks<14>);
+            schedule.decryptBlocks = byRounds(rounds, aesniDecryptBlocks<10>, aesniDecryptBlocks<12>, aesniDecryptBlocks<14>);
+            break;
+#endif
+        case AES_BACKEND_TTABLE:
+            schedule.encryptBlock = byRounds(rounds, ttableEncrypt<10>, ttableEncrypt<12>, ttableEncrypt<14>);
+            schedule.decryptBlock = byRounds(rounds, ttableDecrypt<10>, ttableDecrypt<12>, ttableDecrypt<14>);
+            schedule.encryptBlocks = byRounds(rounds, ttableEncryptBlocks<10>, ttableEncryptBlocks<12>, ttableEncryptBlocks<14>);
+            schedule.decryptBlocks = byRounds(rounds, ttableDecryptBlocks<10>, ttableDecryptBlocks<12>, ttableDecryptBlocks<14>);
+            break;
+        case AES_BACKEND_BITSLICE:
+        case AES_BACKEND_VPERM:
+            if(schedule.backend == AES_BACKEND_BITSLICE)
             {
-                temp = round_key[i];
-                round_key[i] = round_key[7 - i];
-                round_key[7 - i] = temp;
+                schedule.encryptBlocks = byRounds(rounds, bitsliceEncryptBlocks<10>, bitsliceEncryptBlocks<12>, bitsliceEncryptBlocks<14>);
+                schedule.decryptBlocks = byRounds(rounds, bitsliceDecryptBlocks<10>, bitsliceDecryptBlocks<12>, bitsliceDecryptBlocks<14>);
             }
-            index = 15;
-        }
-        else // index == 15, use first 4 words
-        {
-            for (index = 0; index < 16; index++)
+            schedule.encryptBlock = byRounds(rounds, bitsliceEncryptBlock<10>, bitsliceEncryptBlock<12>, bitsliceEncryptBlock<14>);
+            schedule.decryptBlock = byRounds(rounds, bitsliceDecryptBlock<10>, bitsliceDecryptBlock<12>, bitsliceDecryptBlock<14>);
+#ifdef LIBAES_X86
+            // a lone block would only fill one of the eight bitsliced lanes
+            if(cpuFeatures().ssse3)
             {
-                round_key.push_back(key[index]);
+                schedule.encryptBlock = byRounds(rounds, vpermEncrypt<10>, vpermEncrypt<12>, vpermEncrypt<14>);
+                schedule.decryptBlock = byRounds(rounds, vpermDecrypt<10>, vpermDecrypt<12>, vpermDecrypt<14>);
             }
-            index = 23;
-        }
-        AES.addRoundKey(block, round_key);
-        AES.mixColumnsInv(block);
-        AES.shiftRowsInv(block);
-        AES.sBoxInv(block);
-    }
-
-    round_key.clear();
-    for (index = 0; index < 16; index++) // get first 4 of original key
-    {
-        round_key.push_back(key[index]);
+#endif
+            break;
+        default:
+            schedule.encryptBlock = byRounds(rounds, referenceEncrypt<10>, referenceEncrypt<12>, referenceEncrypt<14>);
+            schedule.decryptBlock = byRounds(rounds, referenceDecrypt<10>, referenceDecrypt<12>, referenceDecrypt<14>);
+            break;
     }
-    AES.addRoundKey(block, round_key);
 }
 
 
-void libAES::aes256Inv(vector<uint8_t>& block, vector<uint8_t>& key)
+aesKeySchedule libAES::expandKey(const vector<uint8_t>& key, aesBackend backend)
 {
-    libAES AES;
-
-    vector<uint8_t> round_key; // spliced key
-    int index; // index of calculated key
-    int key_counter = 1; // pseudo round number ofr key calculation
+    aesKeySchedule schedule;
+    uint8_t temp[4];
+    uint8_t front;
 
-    for(int i = 1; i <= 7; i++) // get end key
+    if(key.size() == 16)      // 128 bit
+        schedule.rounds = 10;
+    else if(key.size() == 24) // 192 bit
+        schedule.rounds = 12;
+    else if(key.size() == 32) // 256 bit
+        schedule.rounds = 14;
+    else
+        throw runtime_error("Invalid key length.");
+
+    // pick the hardware path when asked for (or allowed to) and available
+    // without AES-NI, AUTO stays constant-time rather than use the tables
+    if(backend == AES_BACKEND_AUTO && !cpuFeatures().aesni)
+        backend = AES_BACKEND_BITSLICE;
+    if((backend == AES_BACKEND_AUTO || backend == AES_BACKEND_VAES) && !cpuFeatures().vaes)
+        backend = AES_BACKEND_AESNI;
+    else if(backend == AES_BACKEND_AUTO)
+        backend = AES_BACKEND_VAES;
+    if(backend == AES_BACKEND_AESNI && !cpuFeatures().aesni)
+        backend = AES_BACKEND_TTABLE;
+    if(backend == AES_BACKEND_VPERM && !cpuFeatures().ssse3)
+        backend = AES_BACKEND_BITSLICE;
+    schedule.backend = backend;
+
+    selectBlockFunctions(schedule);
+
+    // constant-time backends need a constant-time key expansion as well
+    if(backend == AES_BACKEND_BITSLICE || backend == AES_BACKEND_VPERM)
     {
-        AES.calcRoundKey256(key, i);
+        bitsliceExpandKey(key.data(), schedule);
+        return schedule;
     }
 
-    for (index = 0; index < 16; index++)
+#ifdef LIBAES_X86
+    if(backend == AES_BACKEND_AESNI || backend == AES_BACKEND_VAES)
     {
-        round_key.push_back(key[index]);
+        aesniExpandKey(key.data(), schedule);
+        return schedule;
     }
+#endif
 
-    AES.addRoundKey(block, round_key);
-    index = 31;
-    AES.shiftRowsInv(block);
-    AES.sBoxInv(block);
+    int key_words = key.size() / 4;
+    int total_words = 4 * (schedule.rounds + 1);
+    copy(key.begin(), key.end(), schedule.roundKeys);
 
-    for(int i = 1; i < 14; i++)
+    // FIPS-197 key expansion, one 4 byte word at a time
+    for(int i = key_words; i < total_words; i++)
     {
-        round_key.clear();
-    
-        if(index == 31) // generate new, use last 4 words
+        for(int j = 0; j < 4; j++)
+            temp[j] = schedule.roundKeys[(i - 1) * 4 + j];
+
+        if(i % key_words == 0) // rotate, substitute and apply Rcon
         {
-            AES.calcRoundKey256Inv(key, key_counter++);
-            for (index = 16; index < 32; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-            index = 15;
+            front = temp[0];
+            temp[0] = SBox_consts[temp[1]] ^ AES_TABLES.rcon[i / key_words - 1];
+            temp[1] = SBox_consts[temp[2]];
+            temp[2] = SBox_consts[temp[3]];
+            temp[3] = SBox_consts[front];
         }
-        else // index == 15,  use first 4 words
+        else if(key_words == 8 && i % key_words == 4) // extra substitution for 256 bit keys
         {
-            for (index = 0; index < 16; index++)
-            {
-                round_key.push_back(key[index]);
-            }
-            index = 31;
+            for(int j = 0; j < 4; j++)
+                temp[j] = SBox_consts[temp[j]];
         }
 
-        AES.addRoundKey(block, round_key);
-        AES.mixColumnsInv(block);
-        AES.shiftRowsInv(block);
-        AES.sBoxInv(block);
+        for(int j = 0; j < 4; j++)
+            schedule.roundKeys[i * 4 + j] = schedule.roundKeys[(i - key_words) * 4 + j] ^ temp[j];
     }
 
-    round_key.clear();
-    for (index = 0; index < 16; index++)
+    // decryption keys for the equivalent inverse cipher (FIPS-197 5.3.5):
+    // reverse order, InvMixColumns on every key but the first and last
+    aesBlock roundKey;
+    for(int i = 0; i <= schedule.rounds; i++)
     {
-        round_key.push_back(key[index]);
+        const uint8_t* source = schedule.roundKeys + ((schedule.rounds - i) * 16);
+        copy(source, source + 16, roundKey.bytes);
+        if(i > 0 && i < schedule.rounds)
+            mixColumnsInv(roundKey);
+        copy(roundKey.bytes, roundKey.bytes + 16, schedule.decRoundKeys + (i * 16));
     }
-    AES.addRoundKey(block, round_key);
+
+    return schedule;
 }
 
 
-vector<uint8_t> libAES::gfMult128(const vector<uint8_t>& X, const vector<uint8_t>& Y)
+void libAES::aesEncrypt(aesBlock& block, const aesKeySchedule& schedule)
 {
-    vector<uint8_t> Z = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
-    vector<uint8_t> V = Y;
-
-    for (int i = 0; i < 128; ++i)
-    {
-        int byte_index = i / 8;
-        int bit_index = 7 - (i % 8);
-        bool xbit = (X[byte_index] >> bit_index) & 1;
+    schedule.encryptBlock(block.bytes, block.bytes, schedule);
+}
 
-        if (xbit) {
-            for (int j = 0; j < 16; ++j)
-                Z[j] ^= V[j];
-        }
 
-        bool carry = V[15] & 1;
-        for (int j = 15; j > 0; --j) {
-            V[j] = (V[j] >> 1) | ((V[j - 1] & 0x01) << 7);
-        }
-        V[0] >>= 1;
+void libAES::aesEncrypt(vector<uint8_t>& block, const aesKeySchedule& schedule)
+{
+    aesBlock temp = loadBlock(block);
+    aesEncrypt(temp, schedule);
+    storeBlock(temp, block);
+}
 
-        if (carry) {
-            V[0] ^= 0xE1;
-        }
-    }
 
-    return Z;
+void libAES::aesDecrypt(aesBlock& block, const aesKeySchedule& schedule)
+{
+    schedule.decryptBlock(block.bytes, block.bytes, schedule);
 }
 
 
-void libAES::aesECB(vector<uint8_t>& binaryData, vector<uint8_t>& key, int enc_dec)
+void libAES::aesDecrypt(vector<uint8_t>& block, const aesKeySchedule& schedule)
 {
-    libAES AES;
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
-
-    if(!enc_dec) // encryption
-    {
-        AES.padBinary(binaryData);
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
-        {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            if(key.size() == 16)      // 128 bit
-                AES.aes128(block, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192(block, key);
-            else if(key.size() == 24) // 256 bit
-                AES.aes256(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        }
-    }
-    else // decryption
-    {
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
-        {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            if(key.size() == 16)      // 128 bit
-                AES.aes128Inv(block, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192Inv(block, key);
-            else if(key.size() == 24) // 256 bit
-                AES.aes256Inv(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        }
-        AES.unpadBinary(binaryData);
-    }
+    aesBlock temp = loadBlock(block);
+    aesDecrypt(temp, schedule);
+    storeBlock(temp, block);
 }
 
 
-void libAES::aesECB(const string& filename, vector<uint8_t>& key, int enc_dec)
+void libAES::encryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
 {
-    libAES AES;
-    vector<uint8_t> binaryData = AES.fileToBinary(filename);
-    vector<uint8_t> key_saver = key;
-    vector<uint8_t> block;
+    schedule.encryptBlocks(in, out, blocks, schedule);
+}
 
-    if(!enc_dec) // encryption
-    {
-        AES.padBinary(binaryData);
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
-        {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            if(key.size() == 16)      // 128 bit
-                AES.aes128(block, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192(block, key);
-            else if(key.size() == 32) // 256 bit
-                AES.aes256(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        }
-    }
-    else // decryption
-    {
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
-        {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            if(key.size() == 16)      // 128 bit
-                AES.aes128Inv(block, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192Inv(block, key);
-            else if(key.size() == 32) // 256 bit
-                AES.aes256Inv(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        }
-        AES.unpadBinary(binaryData);
-    }
-    AES.binaryToFile(binaryData, filename);
+
+void libAES::decryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    schedule.decryptBlocks(in, out, blocks, schedule);
 }
 
 
-void libAES::aesCBC(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+void libAES::aes128(vector<uint8_t>& block, const aesKeySchedule& schedule)
 {
-    libAES AES;
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
+    if(schedule.rounds != 10)
+        throw runtime_error("Invalid key length.");
+    aesEncrypt(block, schedule);
+}
 
-    if(iv.size() != 16)
-        throw runtime_error("Invalid IV length");
-    vector<uint8_t> current_iv = iv;
 
+void libAES::aes192(vector<uint8_t>& block, const aesKeySchedule& schedule)
+{
+    if(schedule.rounds != 12)
+        throw runtime_error("Invalid key length.");
+    aesEncrypt(block, schedule);
+}
 
-    if(!enc_dec) // encryption
-    {
-        AES.padBinary(binaryData);
 
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
-        {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            AES.addRoundKey(block, current_iv); // This is just an XOR, so im reusing it here. 
-            if(key.size() == 16)
-                AES.aes128(block, key);
-            else if(key.size() == 24)
-                AES.aes192(block, key);
-            else if(key.size() == 32)
-                AES.aes256(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        }
-    }
-    else // decryption
-    {
-        vector<uint8_t> save_cipher;
+void libAES::aes256(vector<uint8_t>& block, const aesKeySchedule& schedule)
+{
+    if(schedule.rounds != 14)
+        throw runtime_error("Invalid key length.");
+    aesEncrypt(block, schedule);
+}
 
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
-        {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            save_cipher = block;
-            if(key.size() == 16)
-                AES.aes128Inv(block, key);
-            else if(key.size() == 24) 
-                AES.aes192Inv(block, key);
-            else if(key.size() == 32)
-                AES.aes256Inv(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            AES.addRoundKey(block, current_iv);
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = save_cipher;
-        }
-        AES.unpadBinary(binaryData);
-    }
+
+void libAES::aes128Inv(vector<uint8_t>& block, const aesKeySchedule& schedule)
+{
+    if(schedule.rounds != 10)
+        throw runtime_error("Invalid key length.");
+    aesDecrypt(block, schedule);
 }
 
 
-void libAES::aesCBC(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+void libAES::aes192Inv(vector<uint8_t>& block, const aesKeySchedule& schedule)
 {
-    libAES AES;
-    vector<uint8_t> binaryData = AES.fileToBinary(filename);
-    vector<uint8_t> key_saver = key;
+    if(schedule.rounds != 12)
+        throw runtime_error("Invalid key length.");
+    aesDecrypt(block, schedule);
+}
 
-    if(iv.size() != 16)
-        throw runtime_error("Invalid IV length");
-    vector<uint8_t> current_iv = iv;
-    vector<uint8_t> block;
 
-    if(!enc_dec) // encryption
+void libAES::aes256Inv(vector<uint8_t>& block, const aesKeySchedule& schedule)
+{
+    if(schedule.rounds != 14)
+        throw runtime_error("Invalid key length.");
+    aesDecrypt(block, schedule);
+}
+
+
+aesBlock libAES::gfMult128(const aesBlock& X, const aesBlock& Y)
+{
+    // the constant-time ctmul product, the bits of X and Y never pick a branch
+    return ghashMultiply(X, Y);
+}
+
+
+vector<uint8_t> libAES::gfMult128(const vector<uint8_t>& X, const vector<uint8_t>& Y)
+{
+    aesBlock Z = gfMult128(loadBlock(X), loadBlock(Y));
+    return vector<uint8_t>(Z.bytes, Z.bytes + 16);
+}
+
+
+void libAES::ghashUpdate(aesBlock& state, const aesBlock& H, const uint8_t* data, size_t length)
+{
+    // the last partial block is zero padded
+    for(size_t i = 0; i < length; i += 16)
     {
-        AES.padBinary(binaryData);
+        size_t count = min<size_t>(16, length - i);
+        for(size_t j = 0; j < count; j++)
+            state[j] ^= data[i + j];
+        state = gfMult128(state, H);
+    }
+}
 
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
-        {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            AES.addRoundKey(block, current_iv); // This is just an XOR, so im reusing it here. 
-            if(key.size() == 16)
-                AES.aes128(block, key);
-            else if(key.size() == 24)
-                AES.aes192(block, key);
-            else if(key.size() == 32)
-                AES.aes256(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        }
+
+ghashKey libAES::expandGhashKey(const aesKeySchedule& schedule)
+{
+    ghashKey key;
+    key.H = {};
+    aesEncrypt(key.H, schedule);
+
+#ifdef LIBAES_X86
+    if(cpuFeatures().pclmul && cpuFeatures().ssse3)
+    {
+        ghashPclmulInit(key);
+        key.update = cpuFeatures().vpclmul ? ghashVpclmulUpdate : ghashPclmulUpdate;
+        return key;
+    }
+#endif
+
+    // the T-table cipher already indexes tables with secret data, the
+    // other backends get the constant-time GHASH
+    if(schedule.backend == AES_BACKEND_TTABLE)
+    {
+        ghashTableInit(key);
+        key.update = ghashTableUpdate;
+        return key;
+    }
+
+    key.update = ghashCtmulUpdate;
+    return key;
+}
+
+
+void libAES::ghashUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length)
+{
+    key.update(state, key, data, length);
+}
+
+
+#ifdef LIBAES_X86
+// the stitched GCM kernel needs AES-NI round keys and the PCLMULQDQ powers
+// of H that expandGhashKey makes under the same condition
+static gcmBlocksFunction selectGcmBlocks(const aesKeySchedule& schedule, int enc_dec)
+{
+    bool aesni_key = (schedule.backend == AES_BACKEND_AESNI || schedule.backend == AES_BACKEND_VAES);
+    if(!aesni_key || !cpuFeatures().pclmul || !cpuFeatures().ssse3)
+        return nullptr;
+
+    if(enc_dec)
+        return byRounds(schedule.rounds, aesniGcmDecryptBlocks<10>, aesniGcmDecryptBlocks<12>, aesniGcmDecryptBlocks<14>);
+    return byRounds(schedule.rounds, aesniGcmEncryptBlocks<10>, aesniGcmEncryptBlocks<12>, aesniGcmEncryptBlocks<14>);
+}
+#endif
+
+
+void libAES::aesECB(vector<uint8_t>& binaryData, const vector<uint8_t>& key, int enc_dec)
+{
+    aesECB(binaryData, expandKey(key), enc_dec);
+}
+
+
+void libAES::aesECB(const string& filename, const vector<uint8_t>& key, int enc_dec)
+{
+    aesECB(filename, expandKey(key), enc_dec);
+}
+
+
+// runs a multi block function over blocks split into one range per thread
+static void parallelBlocks(unsigned threads, aesBlocksFunction function, const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    unsigned parts = parallelThreads(threads, blocks);
+    parallelFor(parts, [&](size_t part)
+    {
+        size_t first = blocks * part / parts;
+        size_t last = blocks * (part + 1) / parts;
+        function(in + (first * 16), out + (first * 16), last - first, schedule);
+    });
+}
+
+
+size_t libAES::aesECB(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, int enc_dec)
+{
+    if(!enc_dec) // encryption
+    {
+        size_t full_blocks = length / 16;
+        size_t tail = length % 16;
+
+        // PKCS#7 only touches the last block, so build it on the side
+        aesBlock last;
+        copy(in + (full_blocks * 16), in + length, last.bytes);
+        fill(last.bytes + tail, last.bytes + 16, static_cast<uint8_t>(16 - tail));
+
+        parallelBlocks(threads, schedule.encryptBlocks, in, out, full_blocks, schedule);
+        schedule.encryptBlock(last.bytes, out + (full_blocks * 16), schedule);
+        return (full_blocks + 1) * 16;
     }
     else // decryption
     {
-        vector<uint8_t> save_cipher;
+        if(length % 16 != 0)
+            throw runtime_error("Invalid data length");
+        parallelBlocks(threads, schedule.decryptBlocks, in, out, length / 16, schedule);
+        return unpaddedLength(out, length);
+    }
+}
+
 
-        for(int i = 0; i < static_cast<int>(binaryData.size()) / 16; i++)
+void libAES::aesECB(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, int enc_dec)
+{
+    if(!enc_dec) // encryption
+    {
+        size_t length = binaryData.size();
+        size_t padded_length = ((length / 16) + 1) * 16;
+
+        // if the padded data does not fit, encrypt straight into a buffer of
+        // the right size rather than growing (and copying) the plaintext first
+        if(binaryData.capacity() >= padded_length)
         {
-            key = key_saver;
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            save_cipher = block;
-            if(key.size() == 16)
-                AES.aes128Inv(block, key);
-            else if(key.size() == 24) 
-                AES.aes192Inv(block, key);
-            else if(key.size() == 32)
-                AES.aes256Inv(block, key);
-            else
-                throw runtime_error("Invalid key length.");
-            AES.addRoundKey(block, current_iv);
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = save_cipher;
+            binaryData.resize(padded_length);
+            aesECB(binaryData.data(), binaryData.data(), length, schedule, enc_dec);
+        }
+        else
+        {
+            vector<uint8_t> grown(padded_length);
+            aesECB(binaryData.data(), grown.data(), length, schedule, enc_dec);
+            binaryData.swap(grown);
         }
-        AES.unpadBinary(binaryData);
     }
-    AES.binaryToFile(binaryData, filename);
+    else // decryption
+        binaryData.resize(aesECB(binaryData.data(), binaryData.data(), binaryData.size(), schedule, enc_dec));
+}
+
+
+void libAES::aesECB(const string& filename, const aesKeySchedule& schedule, int enc_dec)
+{
+    vector<uint8_t> binaryData = fileToBinary(filename);
+    aesECB(binaryData, schedule, enc_dec);
+    binaryToFile(binaryData, filename);
+}
+
+
+void libAES::aesCBC(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+{
+    aesCBC(binaryData, expandKey(key), iv, enc_dec);
 }
 
 
-void libAES::aesCFB(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+void libAES::aesCBC(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
 {
-    libAES AES;
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
+    aesCBC(filename, expandKey(key), iv, enc_dec);
+}
+
+
+// CBC decryption of one range of blocks, a batch at a time, current_iv is the
+// cipher block before the range; in may equal out
+void cbcDecryptRange(const aesKeySchedule& schedule, aesBlock current_iv, const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    uint8_t save_cipher[BATCH_BLOCKS * 16];
+
+    for(size_t i = 0; i < blocks; i += BATCH_BLOCKS)
+    {
+        size_t count = min(BATCH_BLOCKS, blocks - i);
+        uint8_t* chunk = out + (i * 16);
+
+        copy(in + (i * 16), in + ((i + count) * 16), save_cipher);
+        schedule.decryptBlocks(in + (i * 16), chunk, count, schedule);
+
+        // xor with the previous cipher block
+        for(int j = 0; j < 16; j++)
+            chunk[j] ^= current_iv[j];
+        for(size_t j = 16; j < count * 16; j++)
+            chunk[j] ^= save_cipher[j - 16];
+        copy(save_cipher + ((count - 1) * 16), save_cipher + (count * 16), current_iv.bytes);
+    }
+}
+
+
+size_t libAES::aesCBC(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    aesBlock current_iv;
 
     if(iv.size() != 16)
         throw runtime_error("Invalid IV length");
-    vector<uint8_t> current_iv = iv;
+    copy(iv.begin(), iv.end(), current_iv.bytes);
+
 
     if(!enc_dec) // encryption
     {
-        for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
-        {
-            key = key_saver;
-            if(key.size() == 16)      // 128 bit
-                AES.aes128(current_iv, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192(current_iv, key);
-            else if(key.size() == 32)  // 256 bit
-                AES.aes256(current_iv, key);
-            else
-                throw runtime_error("Invalid key length.");
+        size_t full_blocks = length / 16;
+        size_t tail = length % 16;
 
-            if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            else
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-        
-            AES.addRoundKey(block, current_iv);
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = block;
+        // PKCS#7 only touches the last block, so build it on the side
+        aesBlock last;
+        copy(in + (full_blocks * 16), in + length, last.bytes);
+        fill(last.bytes + tail, last.bytes + 16, static_cast<uint8_t>(16 - tail));
+
+        for(size_t i = 0; i <= full_blocks; i++)
+        {
+            const uint8_t* chunk = (i < full_blocks) ? in + (i * 16) : last.bytes;
+            addRoundKey(current_iv, chunk); // This is just an XOR, so im reusing it here. 
+            aesEncrypt(current_iv, schedule);
+            copy(current_iv.bytes, current_iv.bytes + 16, out + (i * 16));
         }
+        return (full_blocks + 1) * 16;
     }
-    else // decryption
+    else // decryption, each block only needs its own and the previous cipher block
     {
-        vector<uint8_t> save_cipher;
-
-        for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
+        if(length % 16 != 0)
+            throw runtime_error("Invalid data length");
+        size_t total_blocks = length / 16;
+        unsigned parts = parallelThreads(threads, total_blocks);
+
+        // ranges may be decrypted in place, so keep the cipher block before
+        // each one before another thread overwrites it
+        vector<aesBlock> range_iv(parts);
+        for(size_t part = 0; part < parts; part++)
         {
-            key = key_saver;
-            if(key.size() == 16)      // 128 bit
-                AES.aes128(current_iv, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192(current_iv, key);
-            else if(key.size() == 32)  // 256 bit
-                AES.aes256(current_iv, key);
+            size_t first = total_blocks * part / parts;
+            if(first == 0)
+                range_iv[part] = current_iv;
             else
-                throw runtime_error("Invalid key length.");
-            
-            if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            else
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-
-            save_cipher = block;
-            AES.addRoundKey(block, current_iv);
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = save_cipher;
+                copy(in + ((first - 1) * 16), in + (first * 16), range_iv[part].bytes);
         }
+
+        parallelFor(parts, [&](size_t part)
+        {
+            size_t first = total_blocks * part / parts;
+            size_t last = total_blocks * (part + 1) / parts;
+            cbcDecryptRange(schedule, range_iv[part], in + (first * 16), out + (first * 16), last - first);
+        });
+
+        // padding is only checked once the whole message is back
+        return unpaddedLength(out, length);
+    }
+}
+
+
+void libAES::aesCBC(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    size_t length = binaryData.size();
+
+    // encryption pads in place, after the iv is known to be good
+    if(iv.size() != 16)
+        throw runtime_error("Invalid IV length");
+    if(!enc_dec)
+        binaryData.resize(((length / 16) + 1) * 16);
+
+    binaryData.resize(aesCBC(binaryData.data(), binaryData.data(), length, schedule, iv, enc_dec));
+}
+
+
+void libAES::aesCBC(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    vector<uint8_t> binaryData = fileToBinary(filename);
+    aesCBC(binaryData, schedule, iv, enc_dec);
+    binaryToFile(binaryData, filename);
+}
+
+
+void libAES::aesCFB(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+{
+    aesCFB(binaryData, expandKey(key), iv, enc_dec);
+}
+
+
+void libAES::aesCFB(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+{
+    aesCFB(filename, expandKey(key), iv, enc_dec);
+}
+
+
+// CFB decryption of one range, a batch at a time, current_iv is the cipher
+// block before the range; in may equal out
+void cfbDecryptRange(const aesKeySchedule& schedule, aesBlock current_iv, const uint8_t* in, uint8_t* out, size_t data_length)
+{
+    uint8_t keystream[BATCH_BLOCKS * 16];
+    size_t total_blocks = (data_length + 15) / 16;
+
+    for(size_t i = 0; i < total_blocks; i += BATCH_BLOCKS)
+    {
+        size_t count = min(BATCH_BLOCKS, total_blocks - i);
+        const uint8_t* cipher = in + (i * 16);
+        uint8_t* chunk = out + (i * 16);
+        size_t chunk_length = min(count * 16, data_length - (i * 16));
+
+        // cipher inputs are the iv and then every cipher block but the last
+        copy(current_iv.bytes, current_iv.bytes + 16, keystream);
+        copy(cipher, cipher + ((count - 1) * 16), keystream + 16);
+        if(i + count < total_blocks)
+            copy(cipher + ((count - 1) * 16), cipher + (count * 16), current_iv.bytes);
+
+        schedule.encryptBlocks(keystream, keystream, count, schedule);
+        xorKeystream(cipher, keystream, chunk, chunk_length);
     }
 }
 
 
-void libAES::aesCFB(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+void libAES::aesCFB(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
 {
-    libAES AES;
-    vector<uint8_t> binaryData = AES.fileToBinary(filename);
-    vector<uint8_t> key_saver = key;
+    aesBlock current_iv;
+    size_t data_length = length;
+    size_t total_blocks = (data_length + 15) / 16;
 
     if(iv.size() != 16)
         throw runtime_error("Invalid IV length");
-    vector<uint8_t> current_iv = iv;
-    vector<uint8_t> block;
+    copy(iv.begin(), iv.end(), current_iv.bytes);
 
     if(!enc_dec) // encryption
     {
-        for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
+        for(size_t i = 0; i < total_blocks; i++)
         {
-            key = key_saver;
-            if(key.size() == 16)      // 128 bit
-                AES.aes128(current_iv, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192(current_iv, key);
-            else if(key.size() == 32)  // 256 bit
-                AES.aes256(current_iv, key);
-            else
-                throw runtime_error("Invalid key length.");
-            
-            if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            else
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
+            const uint8_t* plain = in + (i * 16);
+            uint8_t* chunk = out + (i * 16);
+            size_t chunk_length = min<size_t>(16, data_length - (i * 16)); // last block may be short
 
-            AES.addRoundKey(block, current_iv);
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = block;
+            aesEncrypt(current_iv, schedule);
+            for(size_t j = 0; j < chunk_length; j++)
+            {
+                chunk[j] = plain[j] ^ current_iv[j];
+                current_iv[j] = chunk[j];
+            }
         }
     }
-    else // decryption
+    else // decryption, the cipher inputs are all known up front so split them like CBC
     {
-        vector<uint8_t> save_cipher;
+        unsigned parts = parallelThreads(threads, total_blocks);
 
-        for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
+        // keep the cipher block before each range before another thread
+        // decrypts it in place, only the last range can end in a short block
+        vector<aesBlock> range_iv(parts);
+        for(size_t part = 0; part < parts; part++)
         {
-            key = key_saver;
-            if(key.size() == 16) // 128 bit
-                AES.aes128(current_iv, key);
-            else if(key.size() == 24) // 192 bit
-                AES.aes192(current_iv, key);
-            else if(key.size() == 32)  // 256 bit
-                AES.aes256(current_iv, key);// 256 bit
+            size_t first = total_blocks * part / parts;
+            if(first == 0)
+                range_iv[part] = current_iv;
             else
-                throw runtime_error("Invalid key length.");
-
-            if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-            else
-                block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-
-            save_cipher = block;
-            AES.addRoundKey(block, current_iv);
-            copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-            current_iv = save_cipher;
+                copy(in + ((first - 1) * 16), in + (first * 16), range_iv[part].bytes);
         }
+
+        parallelFor(parts, [&](size_t part)
+        {
+            size_t first = total_blocks * part / parts;
+            size_t last = total_blocks * (part + 1) / parts;
+            size_t begin = first * 16;
+            size_t end = min(last * 16, data_length);
+            cfbDecryptRange(schedule, range_iv[part], in + begin, out + begin, end - begin);
+        });
     }
-    AES.binaryToFile(binaryData, filename);
 }
 
 
-void libAES::aesOFB(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+void libAES::aesCFB(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
 {
-    libAES AES;
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
+    aesCFB(binaryData.data(), binaryData.data(), binaryData.size(), schedule, iv, enc_dec);
+}
 
-    if(iv.size() != 16)
-        throw runtime_error("Invalid IV length");
-    vector<uint8_t> current_iv = iv;
-    vector<uint8_t> save_new_iv;
 
-    // encryption and decryption are symetric
-    for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
-    {
-        key = key_saver;
-        if(key.size() == 16)
-            AES.aes128(current_iv, key);
-        else if(key.size() == 24)
-            AES.aes192(current_iv, key);
-        else if(key.size() == 32)
-            AES.aes256(current_iv, key);
-        else
-            throw runtime_error("Invalid key length.");
+void libAES::aesCFB(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    vector<uint8_t> binaryData = fileToBinary(filename);
+    aesCFB(binaryData, schedule, iv, enc_dec);
+    binaryToFile(binaryData, filename);
+}
 
-        save_new_iv = current_iv;
-        if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        else
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-        AES.addRoundKey(block, current_iv);
-        copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        current_iv = save_new_iv;
-    }
+
+void libAES::aesOFB(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+{
+    aesOFB(binaryData, expandKey(key), iv, enc_dec);
 }
 
 
-void libAES::aesOFB(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+void libAES::aesOFB(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
 {
-    libAES AES;
-    vector<uint8_t> binaryData = AES.fileToBinary(filename);
-    vector<uint8_t> key_saver = key;
-    
+    aesOFB(filename, expandKey(key), iv, enc_dec);
+}
+
+
+void libAES::aesOFB(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    aesBlock current_iv;
+    size_t data_length = length;
+
     if(iv.size() != 16)
         throw runtime_error("Invalid IV length");
-    vector<uint8_t> current_iv = iv;
-    vector<uint8_t> block;
-    vector<uint8_t> save_new_iv;
+    copy(iv.begin(), iv.end(), current_iv.bytes);
 
     // encryption and decryption are symetric
-    for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
+    for(size_t i = 0; i < (data_length + 15) / 16; i++)
     {
-        key = key_saver;
-        if(key.size() == 16)
-            AES.aes128(current_iv, key);
-        else if(key.size() == 24)
-            AES.aes192(current_iv, key);
-        else if(key.size() == 32)
-            AES.aes256(current_iv, key);
-        else
-            throw runtime_error("Invalid key length.");
+        const uint8_t* text = in + (i * 16);
+        uint8_t* chunk = out + (i * 16);
+        size_t chunk_length = min<size_t>(16, data_length - (i * 16)); // last block may be short
 
-        save_new_iv = current_iv;
-        if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        else
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-        AES.addRoundKey(block, current_iv);
-        copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        current_iv = save_new_iv;
+        aesEncrypt(current_iv, schedule);
+        for(size_t j = 0; j < chunk_length; j++)
+            chunk[j] = text[j] ^ current_iv[j];
     }
+}
+
 
-    AES.binaryToFile(binaryData, filename);
+void libAES::aesOFB(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    aesOFB(binaryData.data(), binaryData.data(), binaryData.size(), schedule, iv, enc_dec);
 }
 
 
-void libAES::aesCTR(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter = {0x00,0x00,0x00,0x00})
+void libAES::aesOFB(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
 {
-    libAES AES;
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
-    vector<uint8_t> nonce_counter;
-    vector<uint8_t> nonce_counter_saver = iv;
-    uint32_t num = (static_cast<uint32_t>(counter[0]) << 24) | (static_cast<uint32_t>(counter[1]) << 16) | (static_cast<uint32_t>(counter[2]) << 8)  | (static_cast<uint32_t>(counter[3]));
+    vector<uint8_t> binaryData = fileToBinary(filename);
+    aesOFB(binaryData, schedule, iv, enc_dec);
+    binaryToFile(binaryData, filename);
+}
+
+
+void libAES::aesCTR(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter = {0x00,0x00,0x00,0x00})
+{
+    aesCTR(binaryData, expandKey(key), iv, enc_dec, counter);
+}
+
+
+void libAES::aesCTR(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter = {0x00,0x00,0x00,0x00})
+{
+    aesCTR(filename, expandKey(key), iv, enc_dec, counter);
+}
 
-    for(int i = 0; i < 4; i ++)
-        nonce_counter_saver.push_back(counter[i]);
 
-    for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
+// CTR batches are larger, so the wide VAES passes outweigh the call and the
+// counter words
+static const size_t CTR_BATCH_BLOCKS = 128;
+
+
+// CTR over one range of the data, num is the counter of its first block; in
+// may equal out
+void ctrRange(const aesKeySchedule& schedule, aesBlock nonce_counter_saver, uint32_t num, const uint8_t* in, uint8_t* out, size_t data_length)
+{
+    uint8_t counters[CTR_BATCH_BLOCKS * 16];
+    uint8_t keystream[CTR_BATCH_BLOCKS * 16];
+    size_t total_blocks = (data_length + 15) / 16;
+
+    // every block of a batch shares the iv, only the counter words change
+    for(size_t j = 0; j < min(CTR_BATCH_BLOCKS, total_blocks); j++)
+        copy(nonce_counter_saver.bytes, nonce_counter_saver.bytes + 12, counters + (j * 16));
+
+    for(size_t i = 0; i < total_blocks; i += CTR_BATCH_BLOCKS)
     {
-        key = key_saver;
-        nonce_counter = nonce_counter_saver;
-        
-        if(key.size() == 16)      // 128 bit
-            AES.aes128(nonce_counter, key);
-        else if(key.size() == 24) // 192 bit
-            AES.aes192(nonce_counter, key);
-        else if(key.size() == 32)  // 256 bit
-            AES.aes256(nonce_counter, key);
-        else
-            throw runtime_error("Invalid key length.");
-        
-        if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        else
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-        
-        AES.addRoundKey(block, nonce_counter);
-        copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
+        size_t count = min(CTR_BATCH_BLOCKS, total_blocks - i);
+        size_t chunk_length = min(count * 16, data_length - (i * 16));
+
+        for(size_t j = 0; j < count; j++, num++)
+        {
+            uint8_t* word = counters + (j * 16) + 12;
+            word[0] = static_cast<uint8_t>(num >> 24);
+            word[1] = static_cast<uint8_t>(num >> 16);
+            word[2] = static_cast<uint8_t>(num >> 8);
+            word[3] = static_cast<uint8_t>(num);
+        }
 
-        // cumbersome increment of iv
-        num++;
-        for (int j = 0; j < 4; j++) 
-            nonce_counter_saver[iv.size() + j] = num >> ((3 - j) * 8) & 0xFF;
+        schedule.encryptBlocks(counters, keystream, count, schedule);
+        xorKeystream(in + (i * 16), keystream, out + (i * 16), chunk_length);
     }
 }
 
 
-void libAES::aesCTR(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter = {0x00,0x00,0x00,0x00})
+void libAES::aesCTR(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter)
 {
-    libAES AES;
-    vector<uint8_t> binaryData = AES.fileToBinary(filename);
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
-    vector<uint8_t> nonce_counter;
-    vector<uint8_t> nonce_counter_saver = iv;
-    uint32_t num = (static_cast<uint32_t>(counter[0]) << 24) | (static_cast<uint32_t>(counter[1]) << 16) | (static_cast<uint32_t>(counter[2]) << 8)  | (static_cast<uint32_t>(counter[3]));
+    aesBlock nonce_counter_saver;
+    size_t data_length = length;
+    size_t total_blocks = (data_length + 15) / 16;
 
-    for(int i = 0; i < 4; i ++)
-        nonce_counter_saver.push_back(counter[i]);
+    // the block is the 12 byte iv followed by the 32 bit counter, a longer iv
+    // would leave no room for the counter and repeat the keystream
+    if(iv.size() != 12)
+        throw runtime_error("Invalid IV length");
+    if(counter.size() != 4)
+        throw runtime_error("Invalid counter length");
+    for(size_t k = 0; k < 16; k++)
+        nonce_counter_saver[k] = (k < iv.size()) ? iv[k] : counter[k - iv.size()];
+    uint32_t num = (static_cast<uint32_t>(counter[0]) << 24) | (static_cast<uint32_t>(counter[1]) << 16) | (static_cast<uint32_t>(counter[2]) << 8)  | (static_cast<uint32_t>(counter[3]));
 
-    for(int i = 0; i < (static_cast<int>(binaryData.size()) + 15) / 16 ; i++)
+    // every keystream block only depends on its counter, so each thread
+    // takes a range of blocks and starts from that range's counter
+    unsigned parts = parallelThreads(threads, total_blocks);
+    parallelFor(parts, [&](size_t part)
     {
-        key = key_saver;
-        nonce_counter = nonce_counter_saver;
-        
-        if(key.size() == 16)      // 128 bit
-            AES.aes128(nonce_counter, key);
-        else if(key.size() == 24) // 192 bit
-            AES.aes192(nonce_counter, key);
-        else if(key.size() == 32) // 256 bit
-            AES.aes256(nonce_counter, key);
-        else 
-            throw runtime_error("Invalid key length.");
-        
-        if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        else
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-        
-        AES.addRoundKey(block, nonce_counter);
-        copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
+        size_t first = total_blocks * part / parts;
+        size_t last = total_blocks * (part + 1) / parts;
+        size_t begin = first * 16;
+        size_t end = min(last * 16, data_length);
+        ctrRange(schedule, nonce_counter_saver, num + static_cast<uint32_t>(first), in + begin, out + begin, end - begin);
+    });
+}
 
-        // cumbersome increment of iv
-        num++;
-        for (int j = 0; j < 4; j++) 
-            nonce_counter_saver[iv.size() + j] = num >> ((3 - j) * 8) & 0xFF;
-    }
 
-    AES.binaryToFile(binaryData, filename);
+void libAES::aesCTR(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter)
+{
+    aesCTR(binaryData.data(), binaryData.data(), binaryData.size(), schedule, iv, enc_dec, counter);
 }
 
 
-vector<uint8_t> libAES::aesGCM(vector<uint8_t>& binaryData, vector<uint8_t>& AAD, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter = {0x00,0x00,0x00,0x01})
+void libAES::aesCTR(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter)
 {
-    libAES AES;
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
-    vector<uint8_t> nonce_counter;
-    vector<uint8_t> nonce_counter_saver;
-    vector<uint8_t> encNonce;
-    uint32_t num;
-    vector<uint8_t> H = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
-    vector<uint8_t> GHASH = H;
-    vector<uint8_t> length_vector;
+    vector<uint8_t> binaryData = fileToBinary(filename);
+    aesCTR(binaryData, schedule, iv, enc_dec, counter);
+    binaryToFile(binaryData, filename);
+}
 
-    // get lengths of data and AAD for verification
-    uint64_t data_length = binaryData.size();
-    uint64_t AAD_length = AAD.size();
 
-    // Create H and verify key size
-    if(key.size() == 16)      // 128 bit
-        AES.aes128(H, key);
-    else if(key.size() == 24) // 192 bit
-        AES.aes192(H, key);
-    else if(key.size() == 32) // 256 bit
-        AES.aes256(H, key);
-    else
-        throw runtime_error("Invalid Key length");
+void libAES::aesCTRSeek(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& counter_block, uint64_t offset, int counter_bits)
+{
+    aesCTRSeek(binaryData, expandKey(key), counter_block, offset, counter_bits);
+}
 
-    // create nonce and encrypt
-    if(iv.size() == 12)
-    {
-        nonce_counter_saver = iv;
-        for(int i = 0; i < 4; i ++)
-            nonce_counter_saver.push_back(counter[i]);
-        num = (static_cast<uint32_t>(counter[0]) << 24) | (static_cast<uint32_t>(counter[1]) << 16) | (static_cast<uint32_t>(counter[2]) << 8)  | (static_cast<uint32_t>(counter[3]));
-    }
-    else
-    {
-        nonce_counter_saver = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
-        // calculate padding
-        vector<uint8_t> iv_padded = iv;
-        while(iv_padded.size() % 16 != 0)
-            iv_padded.push_back(0x00);
-        for (int i = 0; i < 8; i++)
-            iv_padded.push_back(0x00);
 
-        // append length value
-        uint64_t iv_bitlen = iv.size() * 8;
-        for (int i = 0; i < 8; i++)
-            iv_padded.push_back((iv_bitlen >> (56 - i * 8)) & 0xFF);
+void libAES::aesCTRSeek(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& counter_block, uint64_t offset, size_t length, int counter_bits)
+{
+    aesCTRSeek(filename, expandKey(key), counter_block, offset, length, counter_bits);
+}
 
-        // compress the nonce_counter_saver 
-        for (uint64_t i = 0; i < iv_padded.size() / 16; i++) 
-        {
-            vector<uint8_t> block(iv_padded.begin() + (i * 16), iv_padded.begin() + (i + 1) * 16);
-            AES.addRoundKey(nonce_counter_saver, block);
-            nonce_counter_saver = AES.gfMult128(nonce_counter_saver, H);
-        }
-        num = (static_cast<uint32_t>(nonce_counter_saver[12]) << 24) | (static_cast<uint32_t>(nonce_counter_saver[13]) << 16) | (static_cast<uint32_t>(nonce_counter_saver[14]) << 8)  | (static_cast<uint32_t>(nonce_counter_saver[15]));
+
+// adds n to the low counter_bits bits of a big endian counter block, the
+// bits above them are left alone
+static void ctrAdd(aesBlock& block, uint64_t n, int counter_bits)
+{
+    unsigned carry = 0;
+    for(int i = 15, bit = 0; i >= 0 && bit < counter_bits && (n != 0 || carry != 0); i--, bit += 8)
+    {
+        unsigned sum = block[i] + static_cast<uint8_t>(n) + carry;
+        uint8_t mask = (counter_bits - bit >= 8) ? 0xff : static_cast<uint8_t>((1 << (counter_bits - bit)) - 1);
+        block[i] = static_cast<uint8_t>((block[i] & ~mask) | (sum & mask));
+        carry = sum >> 8;
+        n >>= 8;
     }
+}
 
-    encNonce = nonce_counter_saver;
-    key = key_saver;
-    if(key.size() == 16)      // 128 bit
-        AES.aes128(encNonce, key);
-    else if(key.size() == 24) // 192 bit
-        AES.aes192(encNonce, key);
-    else                      // 256 bit
-        AES.aes256(encNonce, key);
 
-    num++;
-    for (int j = 0; j < 4; j++) 
-        nonce_counter_saver[12 + j] = num >> ((3 - j) * 8) & 0xFF;
-    
+// CTR over whole blocks, counter is the counter block of the first one
+static void ctrSeekRange(const aesKeySchedule& schedule, aesBlock counter, int counter_bits, uint8_t* data, size_t data_length)
+{
+    uint8_t keystream[BATCH_BLOCKS * 16];
+    size_t total_blocks = (data_length + 15) / 16;
 
-    // Pad binary AAD with zeros for authentication
-    if(AAD.size() > 0)
+    for(size_t i = 0; i < total_blocks; i += BATCH_BLOCKS)
     {
-        int AAD_padding_counter = 0;
-        while(AAD.size() % 16 != 0)
-        {
-            AAD.insert(AAD.end(), 0x00);
-            AAD_padding_counter++;
-        }
-        for(uint64_t i = 0; i < AAD.size() / 16; i++)
+        size_t count = min(BATCH_BLOCKS, total_blocks - i);
+        uint8_t* chunk = data + (i * 16);
+        size_t chunk_length = min(count * 16, data_length - (i * 16));
+
+        for(size_t j = 0; j < count; j++)
         {
-            AES.addRoundKey(GHASH, vector<uint8_t>(AAD.begin() + (i * 16), AAD.begin() + (i + 1) * 16));
-            GHASH = AES.gfMult128(GHASH, H);
+            copy(counter.bytes, counter.bytes + 16, keystream + (j * 16));
+            ctrAdd(counter, 1, counter_bits);
         }
-        for(int i = 0; i < AAD_padding_counter; i++)
-            AAD.pop_back();
+
+        schedule.encryptBlocks(keystream, keystream, count, schedule);
+        xorKeystream(chunk, keystream, chunk, chunk_length);
     }
+}
+
+
+void libAES::aesCTRSeek(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& counter_block, uint64_t offset, int counter_bits)
+{
+    if(counter_block.size() != 16)
+        throw runtime_error("Invalid counter block length");
+    if(counter_bits < 1 || counter_bits > 128)
+        throw runtime_error("Invalid counter width");
+
+    size_t data_length = binaryData.size();
+    if(data_length == 0)
+        return;
+    if(offset + data_length < offset)
+        throw runtime_error("CTR range past the end of the stream");
+
+    // block index of the first byte, and how far into that block it is
+    uint64_t first_block = offset / 16;
+    size_t skip = offset % 16;
+    uint64_t end_block = (offset + data_length - 1) / 16;
+
+    // the counter may wrap inside its bits but must not come back to a value
+    // the stream already used
+    if(counter_bits < 64 && end_block >> counter_bits != 0)
+        throw runtime_error("CTR range past the end of the counter");
 
-    // encryption
-    for(uint64_t i = 0; i < (data_length + 15) / 16; i++)
+    aesBlock counter = loadBlock(counter_block);
+    ctrAdd(counter, first_block, counter_bits);
+
+    // partial leading block
+    size_t head = 0;
+    if(skip != 0)
     {
-        key = key_saver;
-        nonce_counter = nonce_counter_saver;
-
-        if(key.size() == 16)      // 128 bit
-            AES.aes128(nonce_counter, key);
-        else if(key.size() == 24) // 192 bit
-            AES.aes192(nonce_counter, key);
-        else                      // 256 bit
-            AES.aes256(nonce_counter, key);
-
-        if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        else
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-        
-        if(enc_dec) // decryption
-        {
-            int pad_counter = 0;
-            if(block.size() % 16 != 0)
-            {
-                while(block.size() % 16 != 0)
-                {
-                    block.push_back(0x00);
-                    pad_counter++;
-                }
-            }
-            
-            AES.addRoundKey(GHASH, block);
-            GHASH = AES.gfMult128(GHASH, H);
+        aesBlock keystream = counter;
+        schedule.encryptBlock(keystream.bytes, keystream.bytes, schedule);
+        head = min(16 - skip, data_length);
+        for(size_t j = 0; j < head; j++)
+            binaryData[j] ^= keystream[skip + j];
+        ctrAdd(counter, 1, counter_bits);
+    }
+
+    // the rest is block aligned, split it like aesCTR
+    uint8_t* data = binaryData.data() + head;
+    size_t rest_length = data_length - head;
+    size_t total_blocks = (rest_length + 15) / 16;
+    unsigned parts = parallelThreads(threads, total_blocks);
+    parallelFor(parts, [&](size_t part)
+    {
+        size_t first = total_blocks * part / parts;
+        size_t last = total_blocks * (part + 1) / parts;
+        size_t begin = first * 16;
+        size_t end = min(last * 16, rest_length);
+        aesBlock start = counter;
+        ctrAdd(start, first, counter_bits);
+        ctrSeekRange(schedule, start, counter_bits, data + begin, end - begin);
+    });
+}
 
-            for(int i = 0; i < pad_counter; i++)
-                block.pop_back();
-        }
 
-        AES.addRoundKey(block, nonce_counter);
-        copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        
-        if(!enc_dec) // encryption
-        {
-            int pad_counter = 0;
-            if(block.size() % 16 != 0)
-            {
-                while(block.size() % 16 != 0)
-                {
-                    block.push_back(0x00);
-                    pad_counter++;
-                }
-            }
-            
-            AES.addRoundKey(GHASH, block);
-            GHASH = AES.gfMult128(GHASH, H);
+// only the range is read and written back, the rest of the file is not touched
+void libAES::aesCTRSeek(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& counter_block, uint64_t offset, size_t length, int counter_bits)
+{
+    fstream file(filename, ios::in | ios::out | ios::binary);
 
-            for(int i = 0; i < pad_counter; i++)
-                block.pop_back();
-        }
+    if (!file) {
+        throw runtime_error("Failed to open file for reading");
+    }
+
+    // a range running past the end of the file stops there, so only what
+    // the file has is allocated and read
+    file.seekg(0, ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    size_t available = (offset < size) ? static_cast<size_t>(min<uint64_t>(length, size - offset)) : 0;
+    if(available == 0)
+        return;
 
-        // cumbersome increment of iv
-        num++;
-        for (int j = 0; j < 4; j++) 
-            nonce_counter_saver[12 + j] = num >> ((3 - j) * 8) & 0xFF;
+    vector<uint8_t> binaryData(available);
+    file.seekg(offset);
+    file.read(reinterpret_cast<char*>(binaryData.data()), available);
+    if (!file) {
+        throw runtime_error("Error reading from file");
     }
 
-    // handle length verification
-    for (int i = 0; i < 8; i++)
-        length_vector.push_back((AAD_length * 8) >> (56 - 8 * i));
-    for (int i = 0; i < 8; i++)
-        length_vector.push_back((data_length * 8) >> (56 - 8 * i));
-        
-    AES.addRoundKey(GHASH, length_vector);
-    GHASH = AES.gfMult128(GHASH, H);
-    AES.addRoundKey(GHASH, encNonce);
+    aesCTRSeek(binaryData, schedule, counter_block, offset, counter_bits);
 
-    if (enc_dec)
-        if (GHASH != expected_tag)
-            throw runtime_error("Tag mismatch: authentication failed");
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(binaryData.data()), binaryData.size());
 
-    return GHASH;
+    if (!file) {
+        throw runtime_error("Error writing to file");
+    }
 }
 
 
-vector<uint8_t> libAES::aesGCM(const string& filename, const string& AAD_filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter = {0x00,0x00,0x00,0x00})
+vector<uint8_t> libAES::aesGCM(vector<uint8_t>& binaryData, const vector<uint8_t>& AAD, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter = {0x00,0x00,0x00,0x01})
 {
-    libAES AES;
-    vector<uint8_t> binaryData = AES.fileToBinary(filename);
-    vector<uint8_t> AAD;
-    try{ // AAD is not neccessary
-        AAD = AES.fileToBinary(AAD_filename);}
-    catch (const exception& e){}
+    return aesGCM(binaryData, AAD, expandKey(key), iv, enc_dec, expected_tag, counter);
+}
 
-    vector<uint8_t> block;
-    vector<uint8_t> key_saver = key;
-    vector<uint8_t> nonce_counter;
-    vector<uint8_t> nonce_counter_saver;
-    vector<uint8_t> encNonce;
-    uint32_t num;
-    vector<uint8_t> H = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
-    vector<uint8_t> GHASH = H;
-    vector<uint8_t> length_vector;
 
-    // get lengths of data and AAD for verification
-    uint64_t data_length = binaryData.size();
-    uint64_t AAD_length = AAD.size();
+vector<uint8_t> libAES::aesGCM(const string& filename, const string& AAD_filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter = {0x00,0x00,0x00,0x00})
+{
+    return aesGCM(filename, AAD_filename, expandKey(key), iv, enc_dec, expected_tag, counter);
+}
 
-    // Create H and verify key size
-    if(key.size() == 16)      // 128 bit
-        AES.aes128(H, key);
-    else if(key.size() == 24) // 192 bit
-        AES.aes192(H, key);
-    else if(key.size() == 32) // 256 bit
-        AES.aes256(H, key);
-    else
-        throw runtime_error("Invalid Key length");
 
-    // create nonce and encrypt
+// first counter block J0, the 12 byte iv and counter, or any other iv
+// length compressed with GHASH
+aesBlock gcmPreCounter(const ghashKey& H, const vector<uint8_t>& iv, const vector<uint8_t>& counter)
+{
+    aesBlock pre_counter = {};
     if(iv.size() == 12)
     {
-        nonce_counter_saver = iv;
+        if(counter.size() != 4)
+            throw runtime_error("Invalid counter length");
+        copy(iv.begin(), iv.end(), pre_counter.bytes);
         for(int i = 0; i < 4; i ++)
-            nonce_counter_saver.push_back(counter[i]);
-        num = (static_cast<uint32_t>(counter[0]) << 24) | (static_cast<uint32_t>(counter[1]) << 16) | (static_cast<uint32_t>(counter[2]) << 8)  | (static_cast<uint32_t>(counter[3]));
+            pre_counter[12 + i] = counter[i];
     }
     else
     {
-        nonce_counter_saver = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
-        // calculate padding
-        vector<uint8_t> iv_padded = iv;
-        while(iv_padded.size() % 16 != 0)
-            iv_padded.push_back(0x00);
-        for (int i = 0; i < 8; i++)
-            iv_padded.push_back(0x00);
-
-        // append length value
+        // compress the zero padded iv and its bit length
         uint64_t iv_bitlen = iv.size() * 8;
+        H.update(pre_counter, H, iv.data(), iv.size());
+        aesBlock length_block = {};
         for (int i = 0; i < 8; i++)
-            iv_padded.push_back((iv_bitlen >> (56 - i * 8)) & 0xFF);
-
-        // compress the nonce_counter_saver 
-        for (uint64_t i = 0; i < iv_padded.size() / 16; i++) 
-        {
-            vector<uint8_t> block(iv_padded.begin() + (i * 16), iv_padded.begin() + (i + 1) * 16);
-            AES.addRoundKey(nonce_counter_saver, block);
-            nonce_counter_saver = AES.gfMult128(nonce_counter_saver, H);
-        }
-        num = (static_cast<uint32_t>(nonce_counter_saver[12]) << 24) | (static_cast<uint32_t>(nonce_counter_saver[13]) << 16) | (static_cast<uint32_t>(nonce_counter_saver[14]) << 8)  | (static_cast<uint32_t>(nonce_counter_saver[15]));
+            length_block[8 + i] = (iv_bitlen >> (56 - i * 8)) & 0xFF;
+        H.update(pre_counter, H, length_block.bytes, 16);
     }
+    return pre_counter;
+}
 
-    encNonce = nonce_counter_saver;
-    key = key_saver;
-    if(key.size() == 16)      // 128 bit
-        AES.aes128(encNonce, key);
-    else if(key.size() == 24) // 192 bit
-        AES.aes192(encNonce, key);
-    else                      // 256 bit
-        AES.aes256(encNonce, key);
 
-    num++;
-    for (int j = 0; j < 4; j++) 
-        nonce_counter_saver[12 + j] = num >> ((3 - j) * 8) & 0xFF;
-    
+// throws unless the tags match, looking at every byte so the time does not
+// tell how much of a forged tag was right
+void gcmCheckTag(const vector<uint8_t>& tag, const vector<uint8_t>& expected_tag)
+{
+    uint8_t difference = (expected_tag.size() != tag.size());
+    for(size_t i = 0; i < tag.size() && i < expected_tag.size(); i++)
+        difference |= tag[i] ^ expected_tag[i];
+    if(difference)
+        throw runtime_error("Tag mismatch: authentication failed");
+}
+
+
+// moves a counter block on by n, GCM counts in its last 32 bits only
+void gcmCounterAdd(aesBlock& counter, uint64_t n)
+{
+    uint32_t num = (static_cast<uint32_t>(counter[12]) << 24) | (static_cast<uint32_t>(counter[13]) << 16) | (static_cast<uint32_t>(counter[14]) << 8)  | (static_cast<uint32_t>(counter[15]));
+    num += static_cast<uint32_t>(n);
+    for (int k = 0; k < 4; k++)
+        counter[12 + k] = num >> ((3 - k) * 8) & 0xFF;
+}
+
 
-    // Pad binary AAD with zeros for authentication
-    if(AAD.size() > 0)
+// GCM over one range of the data, nonce_counter_saver is the counter block
+// of its first block and GHASH is carried on over its ciphertext
+void gcmRange(const aesKeySchedule& schedule, const ghashKey& H, aesBlock nonce_counter_saver, aesBlock& GHASH, const uint8_t* in, uint8_t* out, uint64_t data_length, int enc_dec)
+{
+    uint32_t num = (static_cast<uint32_t>(nonce_counter_saver[12]) << 24) | (static_cast<uint32_t>(nonce_counter_saver[13]) << 16) | (static_cast<uint32_t>(nonce_counter_saver[14]) << 8)  | (static_cast<uint32_t>(nonce_counter_saver[15]));
+
+    // with AES-NI and PCLMULQDQ one stitched pass does most of the data
+    uint64_t done_blocks = 0;
+#ifdef LIBAES_X86
+    gcmBlocksFunction stitched = selectGcmBlocks(schedule, enc_dec);
+    if(stitched)
     {
-        int AAD_padding_counter = 0;
-        while(AAD.size() % 16 != 0)
-        {
-            AAD.insert(AAD.end(), 0x00);
-            AAD_padding_counter++;
-        }
-        for(uint64_t i = 0; i < AAD.size() / 16; i++)
-        {
-            AES.addRoundKey(GHASH, vector<uint8_t>(AAD.begin() + (i * 16), AAD.begin() + (i + 1) * 16));
-            GHASH = AES.gfMult128(GHASH, H);
-        }
-        for(int i = 0; i < AAD_padding_counter; i++)
-            AAD.pop_back();
+        done_blocks = stitched(in, out, data_length / 16, nonce_counter_saver, GHASH, schedule, H);
+        num += static_cast<uint32_t>(done_blocks);
     }
+#endif
 
-    // encryption
-    for(uint64_t i = 0; i < (data_length + 15) / 16; i++)
+    // encryption, the keystream is generated and the ciphertext hashed a
+    // batch at a time, only the last batch can end in a short block
+    uint64_t total_blocks = (data_length + 15) / 16;
+    uint8_t keystream[BATCH_BLOCKS * 16];
+    for(uint64_t i = done_blocks; i < total_blocks; i += BATCH_BLOCKS)
     {
-        key = key_saver;
-        nonce_counter = nonce_counter_saver;
-
-        if(key.size() == 16)      // 128 bit
-            AES.aes128(nonce_counter, key);
-        else if(key.size() == 24) // 192 bit
-            AES.aes192(nonce_counter, key);
-        else                      // 256 bit
-            AES.aes256(nonce_counter, key);
-
-        if(binaryData.begin() + ((i + 1) * 16) < binaryData.end()) // check if we are on a 16 byte block or not
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.begin() + ((i + 1) * 16));
-        else
-            block = vector<uint8_t>(binaryData.begin() + (i * 16), binaryData.end());
-        
-        if(enc_dec) // decryption
-        {
-            int pad_counter = 0;
-            if(block.size() % 16 != 0)
-            {
-                while(block.size() % 16 != 0)
-                {
-                    block.push_back(0x00);
-                    pad_counter++;
-                }
-            }
-            
-            AES.addRoundKey(GHASH, block);
-            GHASH = AES.gfMult128(GHASH, H);
+        size_t count = min<uint64_t>(BATCH_BLOCKS, total_blocks - i);
+        const uint8_t* text = in + (i * 16);
+        uint8_t* chunk = out + (i * 16);
+        size_t chunk_length = min<uint64_t>(count * 16, data_length - (i * 16));
 
-            for(int i = 0; i < pad_counter; i++)
-                block.pop_back();
+        for(size_t j = 0; j < count; j++)
+        {
+            copy(nonce_counter_saver.bytes, nonce_counter_saver.bytes + 16, keystream + (j * 16));
+            // cumbersome increment of iv
+            num++;
+            for (int k = 0; k < 4; k++) 
+                nonce_counter_saver[12 + k] = num >> ((3 - k) * 8) & 0xFF;
         }
+        schedule.encryptBlocks(keystream, keystream, count, schedule);
+        if(enc_dec) // decryption
+            H.update(GHASH, H, text, chunk_length);
+        xorKeystream(text, keystream, chunk, chunk_length);
 
-        AES.addRoundKey(block, nonce_counter);
-        copy(block.begin(), block.end(), binaryData.begin() + (i * 16));
-        
         if(!enc_dec) // encryption
-        {
-            int pad_counter = 0;
-            if(block.size() % 16 != 0)
-            {
-                while(block.size() % 16 != 0)
-                {
-                    block.push_back(0x00);
-                    pad_counter++;
-                }
-            }
-            
-            AES.addRoundKey(GHASH, block);
-            GHASH = AES.gfMult128(GHASH, H);
+            H.update(GHASH, H, chunk, chunk_length);
+    }
+}
 
-            for(int i = 0; i < pad_counter; i++)
-                block.pop_back();
-        }
 
-        // cumbersome increment of iv
-        num++;
-        for (int j = 0; j < 4; j++) 
-            nonce_counter_saver[12 + j] = num >> ((3 - j) * 8) & 0xFF;
+vector<uint8_t> libAES::aesGCM(const uint8_t* in, uint8_t* out, size_t length, const uint8_t* AAD, size_t AAD_size, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter)
+{
+    aesBlock nonce_counter_saver;
+    aesBlock encNonce;
+    aesBlock GHASH = {};
+    aesBlock length_block;
+
+    // get lengths of data and AAD for verification
+    uint64_t data_length = length;
+    uint64_t AAD_length = AAD_size;
+
+    // Create H and its tables
+    ghashKey H = expandGhashKey(schedule);
+
+    // create nonce and encrypt
+    nonce_counter_saver = gcmPreCounter(H, iv, counter);
+    encNonce = nonce_counter_saver;
+    aesEncrypt(encNonce, schedule);
+    gcmCounterAdd(nonce_counter_saver, 1);
+    
+
+    // AAD is zero padded for authentication
+    ghashUpdate(GHASH, H, AAD, AAD_length);
+
+    // CTR and GHASH are both split into one range per thread. Each range
+    // hashes its own ciphertext from zero (the first from the AAD hash),
+    // and a range of m blocks moves the hash before it up by H^m, so
+    // GHASH = GHASH * H^m + partial, one range after another
+    uint64_t total_blocks = (data_length + 15) / 16;
+    unsigned parts = parallelThreads(threads, total_blocks);
+    vector<aesBlock> partial(parts);
+    partial[0] = GHASH;
+
+    parallelFor(parts, [&](size_t part)
+    {
+        uint64_t first = total_blocks * part / parts;
+        uint64_t last = total_blocks * (part + 1) / parts;
+        uint64_t begin = first * 16;
+        uint64_t end = min(last * 16, data_length);
+
+        aesBlock range_counter = nonce_counter_saver;
+        gcmCounterAdd(range_counter, first);
+
+        gcmRange(schedule, H, range_counter, partial[part], in + begin, out + begin, end - begin, enc_dec);
+    });
+
+    GHASH = partial[0];
+    for(size_t part = 1; part < parts; part++)
+    {
+        uint64_t first = total_blocks * part / parts;
+        uint64_t last = total_blocks * (part + 1) / parts;
+        GHASH = ghashMultiply(GHASH, ghashPower(H.H, last - first));
+        addRoundKey(GHASH, partial[part].bytes);
     }
 
     // handle length verification
     for (int i = 0; i < 8; i++)
-        length_vector.push_back((AAD_length * 8) >> (56 - 8 * i));
+        length_block[i] = (AAD_length * 8) >> (56 - 8 * i);
     for (int i = 0; i < 8; i++)
-        length_vector.push_back((data_length * 8) >> (56 - 8 * i));
+        length_block[8 + i] = (data_length * 8) >> (56 - 8 * i);
         
-    AES.addRoundKey(GHASH, length_vector);
-    GHASH = AES.gfMult128(GHASH, H);
-    AES.addRoundKey(GHASH, encNonce);
+    ghashUpdate(GHASH, H, length_block.bytes, 16);
+    addRoundKey(GHASH, encNonce.bytes);
 
+    vector<uint8_t> tag(GHASH.bytes, GHASH.bytes + 16);
     if (enc_dec)
-        if (GHASH != expected_tag)
-            throw runtime_error("Tag mismatch: authentication failed");
+        gcmCheckTag(tag, expected_tag);
+
+    return tag;
+}
+
+
+vector<uint8_t> libAES::aesGCM(vector<uint8_t>& binaryData, const vector<uint8_t>& AAD, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter)
+{
+    return aesGCM(binaryData.data(), binaryData.data(), binaryData.size(), AAD.data(), AAD.size(), schedule, iv, enc_dec, expected_tag, counter);
+}
+
+
+vector<uint8_t> libAES::aesGCM(const string& filename, const string& AAD_filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter)
+{
+    vector<uint8_t> binaryData = fileToBinary(filename);
+    vector<uint8_t> AAD;
+    try{ // AAD is not neccessary
+        AAD = fileToBinary(AAD_filename);}
+    catch (const exception& e){}
 
-    AES.binaryToFile(binaryData, filename);      
-    return GHASH;
+    vector<uint8_t> tag = aesGCM(binaryData, AAD, schedule, iv, enc_dec, expected_tag, counter);
+    binaryToFile(binaryData, filename);      
+    return tag;
 }
\ No newline at end of file
@@ -1,50 +1,84 @@
+#ifndef LIBAES_H
+#define LIBAES_H
+
 #include <vector>
+#include <string>
 #include <stdint.h>
+#include <stddef.h>
+#include "libAES_tables.h"
 
 using namespace std;
 
+// Block cipher implementation used by aesEncrypt/aesDecrypt
+enum aesBackend
+{
+    AES_BACKEND_AUTO,      // fastest backend the CPU supports, BITSLICE without AES-NI
+    AES_BACKEND_REFERENCE, // byte-wise rounds, straight from FIPS-197
+    AES_BACKEND_TTABLE,    // 32 bit table lookups, see libAES_ttable.cpp
+    AES_BACKEND_AESNI,     // x86 AES instructions, falls back to TTABLE when absent
+    AES_BACKEND_VAES,      // AES-NI plus 256/512 bit VAES for runs of blocks, falls back to AESNI
+    AES_BACKEND_BITSLICE,  // constant-time, eight blocks at a time, single blocks go to VPERM if possible
+    AES_BACKEND_VPERM      // constant-time SSSE3 byte shuffles, one block at a time, falls back to BITSLICE
+};
+
+// One 16 byte block, aligned so it can be loaded straight into an SSE
+// register. Lives on the stack, so the cipher core and modes never allocate.
+struct aesBlock
+{
+    alignas(16) uint8_t bytes[16];
+
+    uint8_t& operator[](int i) { return bytes[i]; }
+    const uint8_t& operator[](int i) const { return bytes[i]; }
+};
+
+struct aesKeySchedule;
+typedef void (*aesBlockFunction)(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+typedef void (*aesBlocksFunction)(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+
+// Expanded key, built once per key and shared by every block of a message.
+// Holds all 11/13/15 round keys back to back, 16 bytes each.
+struct aesKeySchedule
+{
+    alignas(16) uint8_t roundKeys[240];
+    alignas(16) uint8_t decRoundKeys[240]; // reversed, InvMixColumns applied, unused by BITSLICE/VPERM
+    int rounds; // 10, 12 or 14
+    aesBackend backend; // never AES_BACKEND_AUTO once expanded
+
+    // backend code for this key size, picked once by expandKey
+    aesBlockFunction encryptBlock;
+    aesBlockFunction decryptBlock;
+    aesBlocksFunction encryptBlocks;
+    aesBlocksFunction decryptBlocks;
+};
+
+struct ghashKey;
+typedef void (*ghashFunction)(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length);
+
+// GCM hash key H = E(K, 0^128) and the multiples of H the GHASH code
+// precomputes from it, built once per key by expandGhashKey.
+struct ghashKey
+{
+    aesBlock H;
+    uint64_t tableHigh[16]; // nibble i times H, big endian halves
+    uint64_t tableLow[16];
+    alignas(32) uint8_t clmulPowers[8][16]; // H^8 down to H^1 byte reversed, for PCLMULQDQ
+
+    // picked once by expandGhashKey, hashes whole and zero padded blocks
+    ghashFunction update;
+};
+
 class libAES 
 {
     public:
-        uint8_t SBox_consts[256] = {
-            0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
-            0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
-            0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
-            0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
-            0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
-            0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
-            0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
-            0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
-            0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
-            0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
-            0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
-            0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
-            0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
-            0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
-            0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
-            0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
-        };
-
-        const uint8_t SBox_constsInv[256] = {
-            0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
-            0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
-            0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
-            0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
-            0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
-            0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
-            0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
-            0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
-            0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
-            0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
-            0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
-            0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
-            0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
-            0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
-            0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
-            0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
-        };
+        // generated at compile time and shared by all instances, see libAES_tables.h
+        static constexpr const uint8_t (&SBox_consts)[256] = AES_TABLES.sbox;
+        static constexpr const uint8_t (&SBox_constsInv)[256] = AES_TABLES.sboxInv;
     
 
+        // threads used by the parallel modes, 0 is one per hardware thread
+        void setThreads(unsigned count);
+        unsigned getThreads() const;
+
         void printBinaryVector(const vector<uint8_t>& binary_data);
         void padBinary(vector<uint8_t>& binary_data);
         void unpadBinary(vector<uint8_t>& binary_data);
@@ -55,14 +89,23 @@ class libAES
         void shiftRows(vector<uint8_t>& block);
         void mixColumns(vector<uint8_t>& block);
         void addRoundKey(vector<uint8_t>& block, const vector<uint8_t>& key);
+        void addRoundKey(vector<uint8_t>& block, const uint8_t* roundKey);
         vector<uint8_t> rotate(vector<uint8_t>& subBlock, int num_rots);
         uint8_t gfMult(uint8_t data, uint8_t multiplier);
         void calcRoundKey128(vector<uint8_t>& key, int round);
         void calcRoundKey192(vector<uint8_t>& key, int round);
         void calcRoundKey256(vector<uint8_t>& key, int round);
-        void aes128(vector<uint8_t>& block, vector<uint8_t>& key);
-        void aes192(vector<uint8_t>& block, vector<uint8_t>& key);
-        void aes256(vector<uint8_t>& block, vector<uint8_t>& key);
+        void aes128(vector<uint8_t>& block, const vector<uint8_t>& key);
+        void aes192(vector<uint8_t>& block, const vector<uint8_t>& key);
+        void aes256(vector<uint8_t>& block, const vector<uint8_t>& key);
+
+        static void sBox(aesBlock& block);
+        static void shiftRows(aesBlock& block);
+        static void mixColumns(aesBlock& block);
+        static void addRoundKey(aesBlock& block, const uint8_t* roundKey);
+        static void sBoxInv(aesBlock& block);
+        static void shiftRowsInv(aesBlock& block);
+        static void mixColumnsInv(aesBlock& block);
 
         void sBoxInv(vector<uint8_t>& block);
         void shiftRowsInv(vector<uint8_t>& block);
@@ -72,22 +115,74 @@ class libAES
         void calcRoundKey128Inv(vector<uint8_t>& key, int round);
         void calcRoundKey192Inv(vector<uint8_t>& key, int round);
         void calcRoundKey256Inv(vector<uint8_t>& key, int round);
-        void aes128Inv(vector<uint8_t>& block, vector<uint8_t>& key);
-        void aes192Inv(vector<uint8_t>& block, vector<uint8_t>& key);
-        void aes256Inv(vector<uint8_t>& block, vector<uint8_t>& key);
+        void aes128Inv(vector<uint8_t>& block, const vector<uint8_t>& key);
+        void aes192Inv(vector<uint8_t>& block, const vector<uint8_t>& key);
+        void aes256Inv(vector<uint8_t>& block, const vector<uint8_t>& key);
 
+        aesKeySchedule expandKey(const vector<uint8_t>& key, aesBackend backend = AES_BACKEND_AUTO);
+        void aesEncrypt(vector<uint8_t>& block, const aesKeySchedule& schedule);
+        void aesDecrypt(vector<uint8_t>& block, const aesKeySchedule& schedule);
+        void aesEncrypt(aesBlock& block, const aesKeySchedule& schedule);
+        void aesDecrypt(aesBlock& block, const aesKeySchedule& schedule);
+        void encryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+        void decryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+        void aes128(vector<uint8_t>& block, const aesKeySchedule& schedule);
+        void aes192(vector<uint8_t>& block, const aesKeySchedule& schedule);
+        void aes256(vector<uint8_t>& block, const aesKeySchedule& schedule);
+        void aes128Inv(vector<uint8_t>& block, const aesKeySchedule& schedule);
+        void aes192Inv(vector<uint8_t>& block, const aesKeySchedule& schedule);
+        void aes256Inv(vector<uint8_t>& block, const aesKeySchedule& schedule);
+
+        // GF(2^128) product in the GCM field, constant-time
         vector<uint8_t> gfMult128(const vector<uint8_t>& X, const vector<uint8_t>& Y);
+        aesBlock gfMult128(const aesBlock& X, const aesBlock& Y);
+        void ghashUpdate(aesBlock& state, const aesBlock& H, const uint8_t* data, size_t length);
+        ghashKey expandGhashKey(const aesKeySchedule& schedule);
+        void ghashUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length);
+
+        void aesECB(vector<uint8_t>& binaryData, const vector<uint8_t>& key, int enc_dec);
+        void aesECB(const string& filename, const vector<uint8_t>& key, int enc_dec);
+        void aesCBC(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void aesCBC(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void aesCFB(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void aesCFB(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void aesOFB(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void aesOFB(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void aesCTR(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter);
+        void aesCTR(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter);
+        void aesCTRSeek(vector<uint8_t>& binaryData, const vector<uint8_t>& key, const vector<uint8_t>& counter_block, uint64_t offset, int counter_bits);
+        void aesCTRSeek(const string& filename, const vector<uint8_t>& key, const vector<uint8_t>& counter_block, uint64_t offset, size_t length, int counter_bits);
+        vector<uint8_t> aesGCM(vector<uint8_t>& binaryData, const vector<uint8_t>& AAD, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter);
+        vector<uint8_t> aesGCM(const string& filename, const string& AAD_filename, const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter);
+
+        void aesECB(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, int enc_dec);
+        void aesECB(const string& filename, const aesKeySchedule& schedule, int enc_dec);
+        void aesCBC(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesCBC(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesCFB(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesCFB(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesOFB(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesOFB(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesCTR(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter);
+        void aesCTR(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter);
+        void aesCTRSeek(vector<uint8_t>& binaryData, const aesKeySchedule& schedule, const vector<uint8_t>& counter_block, uint64_t offset, int counter_bits);
+        void aesCTRSeek(const string& filename, const aesKeySchedule& schedule, const vector<uint8_t>& counter_block, uint64_t offset, size_t length, int counter_bits);
+        vector<uint8_t> aesGCM(vector<uint8_t>& binaryData, const vector<uint8_t>& AAD, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter);
+        vector<uint8_t> aesGCM(const string& filename, const string& AAD_filename, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter);
+
+        // the same from in to out, which may be the same memory. ECB and CBC
+        // return the output length, up to length + 16 bytes when encrypting.
+        // GCM decryption writes all of out before it checks the tag, so when
+        // it throws, out holds unauthenticated plaintext to be discarded
+        size_t aesECB(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, int enc_dec);
+        size_t aesCBC(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesCFB(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesOFB(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+        void aesCTR(const uint8_t* in, uint8_t* out, size_t length, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter);
+        vector<uint8_t> aesGCM(const uint8_t* in, uint8_t* out, size_t length, const uint8_t* AAD, size_t AAD_size, const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter);
+
+    private:
+        unsigned threads = 1;
+};
 
-        void aesECB(vector<uint8_t>& binaryData, vector<uint8_t>& key, int enc_dec);
-        void aesECB(const string& filename, vector<uint8_t>& key, int enc_dec);
-        void aesCBC(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
-        void aesCBC(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
-        void aesCFB(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
-        void aesCFB(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
-        void aesOFB(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
-        void aesOFB(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
-        void aesCTR(vector<uint8_t>& binaryData, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter);
-        void aesCTR(const string& filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, vector<uint8_t> counter);
-        vector<uint8_t> aesGCM(vector<uint8_t>& binaryData, vector<uint8_t>& AAD, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter);
-        vector<uint8_t> aesGCM(const string& filename, const string& AAD_filename, vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& expected_tag, vector<uint8_t> counter);
-};
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <stdint.h>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+#ifdef LIBAES_X86
+#include <immintrin.h>
+
+// AES-NI backend. Compiled with per-function target attributes so the rest
+// of the library still runs on CPUs without the instructions; it is only
+// reached when cpuFeatures() reports AES-NI.
+
+#define AESNI_TARGET __attribute__((target("aes,sse4.1")))
+
+
+AESNI_TARGET static __m128i expandAssist128(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+
+AESNI_TARGET static void expandAssist192(__m128i& low, __m128i& assist, __m128i& high)
+{
+    assist = _mm_shuffle_epi32(assist, 0x55);
+    low = _mm_xor_si128(low, _mm_slli_si128(low, 4));
+    low = _mm_xor_si128(low, _mm_slli_si128(low, 4));
+    low = _mm_xor_si128(low, _mm_slli_si128(low, 4));
+    low = _mm_xor_si128(low, assist);
+    assist = _mm_shuffle_epi32(low, 0xff);
+    high = _mm_xor_si128(high, _mm_slli_si128(high, 4));
+    high = _mm_xor_si128(high, assist);
+}
+
+
+AESNI_TARGET static __m128i expandAssist256(__m128i key, __m128i other)
+{
+    // second half of a 256 bit step: SubWord without rotation or Rcon
+    __m128i assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(other, 0x00), 0xaa);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+
+// combine the low halves of two registers, and the high half of a with the low half of b
+AESNI_TARGET static __m128i joinLow(__m128i a, __m128i b)
+{
+    return _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 0));
+}
+
+
+AESNI_TARGET static __m128i joinHighLow(__m128i a, __m128i b)
+{
+    return _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 1));
+}
+
+
+AESNI_TARGET void aesniExpandKey(const uint8_t* key, aesKeySchedule& schedule)
+{
+    __m128i* rk = reinterpret_cast<__m128i*>(schedule.roundKeys);
+    __m128i* dk = reinterpret_cast<__m128i*>(schedule.decRoundKeys);
+
+    if(schedule.rounds == 10)
+    {
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+        rk[0] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x01)); rk[1] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x02)); rk[2] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x04)); rk[3] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x08)); rk[4] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x10)); rk[5] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x20)); rk[6] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x40)); rk[7] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x80)); rk[8] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x1b)); rk[9] = k;
+        k = expandAssist128(k, _mm_aeskeygenassist_si128(k, 0x36)); rk[10] = k;
+    }
+    else if(schedule.rounds == 12)
+    {
+        // six words per step, so round keys straddle the 128 bit registers
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+        __m128i high = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(key + 16));
+        __m128i assist;
+        rk[0] = low;
+        rk[1] = high;
+        assist = _mm_aeskeygenassist_si128(high, 0x01); expandAssist192(low, assist, high);
+        rk[1] = joinLow(rk[1], low);
+        rk[2] = joinHighLow(low, high);
+        assist = _mm_aeskeygenassist_si128(high, 0x02); expandAssist192(low, assist, high);
+        rk[3] = low;
+        rk[4] = high;
+        assist = _mm_aeskeygenassist_si128(high, 0x04); expandAssist192(low, assist, high);
+        rk[4] = joinLow(rk[4], low);
+        rk[5] = joinHighLow(low, high);
+        assist = _mm_aeskeygenassist_si128(high, 0x08); expandAssist192(low, assist, high);
+        rk[6] = low;
+        rk[7] = high;
+        assist = _mm_aeskeygenassist_si128(high, 0x10); expandAssist192(low, assist, high);
+        rk[7] = joinLow(rk[7], low);
+        rk[8] = joinHighLow(low, high);
+        assist = _mm_aeskeygenassist_si128(high, 0x20); expandAssist192(low, assist, high);
+        rk[9] = low;
+        rk[10] = high;
+        assist = _mm_aeskeygenassist_si128(high, 0x40); expandAssist192(low, assist, high);
+        rk[10] = joinLow(rk[10], low);
+        rk[11] = joinHighLow(low, high);
+        assist = _mm_aeskeygenassist_si128(high, 0x80); expandAssist192(low, assist, high);
+        rk[12] = low;
+    }
+    else
+    {
+        __m128i k0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+        __m128i k1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 16));
+        rk[0] = k0;
+        rk[1] = k1;
+        k0 = expandAssist128(k0, _mm_aeskeygenassist_si128(k1, 0x01)); rk[2] = k0;
+        k1 = expandAssist256(k1, k0);                                  rk[3] = k1;
+        k0 = expandAssist128(k0, _mm_aeskeygenassist_si128(k1, 0x02)); rk[4] = k0;
+        k1 = expandAssist256(k1, k0);                                  rk[5] = k1;
+        k0 = expandAssist128(k0, _mm_aeskeygenassist_si128(k1, 0x04)); rk[6] = k0;
+        k1 = expandAssist256(k1, k0);                                  rk[7] = k1;
+        k0 = expandAssist128(k0, _mm_aeskeygenassist_si128(k1, 0x08)); rk[8] = k0;
+        k1 = expandAssist256(k1, k0);                                  rk[9] = k1;
+        k0 = expandAssist128(k0, _mm_aeskeygenassist_si128(k1, 0x10)); rk[10] = k0;
+        k1 = expandAssist256(k1, k0);                                  rk[11] = k1;
+        k0 = expandAssist128(k0, _mm_aeskeygenassist_si128(k1, 0x20)); rk[12] = k0;
+        k1 = expandAssist256(k1, k0);                                  rk[13] = k1;
+        k0 = expandAssist128(k0, _mm_aeskeygenassist_si128(k1, 0x40)); rk[14] = k0;
+    }
+
+    // AESDEC expects the round keys in reverse with InvMixColumns applied
+    dk[0] = rk[schedule.rounds];
+    for(int i = 1; i < schedule.rounds; i++)
+        dk[i] = _mm_aesimc_si128(rk[schedule.rounds - i]);
+    dk[schedule.rounds] = rk[0];
+}
+
+
+template<int Rounds>
+AESNI_TARGET void aesniEncrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(schedule.roundKeys);
+    __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), rk[0]);
+
+#pragma GCC unroll 14
+    for(int i = 1; i < Rounds; i++)
+        block = _mm_aesenc_si128(block, rk[i]);
+
+    block = _mm_aesenclast_si128(block, rk[Rounds]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+}
+
+
+template<int Rounds>
+AESNI_TARGET void aesniDecrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    const __m128i* dk = reinterpret_cast<const __m128i*>(schedule.decRoundKeys);
+    __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), dk[0]);
+
+#pragma GCC unroll 14
+    for(int i = 1; i < Rounds; i++)
+        block = _mm_aesdec_si128(block, dk[i]);
+
+    block = _mm_aesdeclast_si128(block, dk[Rounds]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+}
+
+// eight independent blocks per pass, interleaved round by round so the
+// AESENC latency of one block is hidden behind the other seven
+template<int Rounds, bool Decrypt>
+AESNI_TARGET static void aesniBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(Decrypt ? schedule.decRoundKeys : schedule.roundKeys);
+    __m128i b[8];
+
+    for(; blocks >= 8; blocks -= 8, in += 128, out += 128)
+    {
+#pragma GCC unroll 8
+        for(int j = 0; j < 8; j++)
+            b[j] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (j * 16))), rk[0]);
+
+#pragma GCC unroll 14
+        for(int i = 1; i < Rounds; i++)
+        {
+#pragma GCC unroll 8
+            for(int j = 0; j < 8; j++)
+                b[j] = Decrypt ? _mm_aesdec_si128(b[j], rk[i]) : _mm_aesenc_si128(b[j], rk[i]);
+        }
+#pragma GCC unroll 8
+
+        for(int j = 0; j < 8; j++)
+        {
+            b[j] = Decrypt ? _mm_aesdeclast_si128(b[j], rk[Rounds]) : _mm_aesenclast_si128(b[j], rk[Rounds]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (j * 16)), b[j]);
+        }
+    }
+
+    for(; blocks > 0; blocks--, in += 16, out += 16)
+    {
+        if(Decrypt)
+            aesniDecrypt<Rounds>(in, out, schedule);
+        else
+            aesniEncrypt<Rounds>(in, out, schedule);
+    }
+}
+
+
+template<int Rounds>
+AESNI_TARGET void aesniEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    aesniBlocks<Rounds, false>(in, out, blocks, schedule);
+}
+
+
+template<int Rounds>
+AESNI_TARGET void aesniDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    aesniBlocks<Rounds, true>(in, out, blocks, schedule);
+}
+
+template AESNI_TARGET void aesniEncrypt<10>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniEncrypt<12>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniEncrypt<14>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniDecrypt<10>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniDecrypt<12>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniDecrypt<14>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniEncryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniEncryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniEncryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniDecryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniDecryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template AESNI_TARGET void aesniDecryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+
+#endif
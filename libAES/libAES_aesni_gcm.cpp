@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+#ifdef LIBAES_X86
+#include <immintrin.h>
+#include "libAES_clmul.h"
+
+// Stitched GCM for AES-NI keys on CPUs with PCLMULQDQ. Each pass runs the
+// rounds of eight counter blocks with the GHASH multiplies of eight
+// ciphertext blocks slotted in between, so the AES and carry-less multiply
+// units work at the same time and the data is only touched once, read from
+// in and written to out (the same memory when in place). Decryption
+// hashes the ciphertext it is about to decrypt, encryption the ciphertext of
+// the previous pass, which is still in registers.
+
+#define AESNI_GCM_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+
+
+template<int Rounds, bool Decrypt>
+AESNI_GCM_TARGET static size_t gcmBlocks(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key)
+{
+    if(blocks < 8)
+        return 0;
+
+    __m128i rk[Rounds + 1];
+    for(int i = 0; i <= Rounds; i++)
+        rk[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(schedule.roundKeys + (i * 16)));
+
+    __m128i powers[8];
+    for(int i = 0; i < 8; i++)
+        powers[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(key.clmulPowers[i]));
+
+    // byte reversed, the 32 bit big endian counter is the lowest lane and
+    // wraps on its own like inc32
+    __m128i ctr = byteSwap(_mm_load_si128(reinterpret_cast<const __m128i*>(counter.bytes)));
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+    __m128i x = byteSwap(_mm_load_si128(reinterpret_cast<const __m128i*>(hash.bytes)));
+
+    __m128i pending[8]; // ciphertext waiting to be hashed, byte reversed
+    size_t done = 0;
+
+    for(; blocks - done >= 8; done += 8)
+    {
+        const uint8_t* source = in + (done * 16);
+        uint8_t* chunk = out + (done * 16);
+        __m128i b[8];
+
+#pragma GCC unroll 8
+        for(int j = 0; j < 8; j++)
+        {
+            b[j] = _mm_xor_si128(byteSwap(ctr), rk[0]);
+            ctr = _mm_add_epi32(ctr, one);
+        }
+
+        if(Decrypt)
+        {
+#pragma GCC unroll 8
+            for(int j = 0; j < 8; j++)
+                pending[j] = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (j * 16))));
+        }
+        bool hashing = Decrypt || done > 0;
+
+        __m128i low = _mm_setzero_si128();
+        __m128i mid = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+        if(hashing)
+            pending[0] = _mm_xor_si128(pending[0], x);
+
+        // one GHASH multiply after each of the first eight rounds
+#pragma GCC unroll 14
+        for(int r = 1; r < Rounds; r++)
+        {
+#pragma GCC unroll 8
+            for(int j = 0; j < 8; j++)
+                b[j] = _mm_aesenc_si128(b[j], rk[r]);
+            if(r <= 8 && hashing)
+                clmulAccumulate(pending[r - 1], powers[r - 1], low, mid, high);
+        }
+        if(hashing)
+            x = clmulReduce(low, mid, high);
+
+#pragma GCC unroll 8
+        for(int j = 0; j < 8; j++)
+        {
+            __m128i text = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (j * 16)));
+            __m128i result = _mm_xor_si128(_mm_aesenclast_si128(b[j], rk[Rounds]), text);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(chunk + (j * 16)), result);
+            if(!Decrypt)
+                pending[j] = byteSwap(result);
+        }
+    }
+
+    // encryption still owes the hash of the last pass
+    if(!Decrypt)
+    {
+        __m128i low = _mm_setzero_si128();
+        __m128i mid = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+        pending[0] = _mm_xor_si128(pending[0], x);
+#pragma GCC unroll 8
+        for(int j = 0; j < 8; j++)
+            clmulAccumulate(pending[j], powers[j], low, mid, high);
+        x = clmulReduce(low, mid, high);
+    }
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(counter.bytes), byteSwap(ctr));
+    _mm_store_si128(reinterpret_cast<__m128i*>(hash.bytes), byteSwap(x));
+    return done;
+}
+
+
+template<int Rounds>
+size_t aesniGcmEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key)
+{
+    return gcmBlocks<Rounds, false>(in, out, blocks, counter, hash, schedule, key);
+}
+
+
+template<int Rounds>
+size_t aesniGcmDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key)
+{
+    return gcmBlocks<Rounds, true>(in, out, blocks, counter, hash, schedule, key);
+}
+
+template size_t aesniGcmEncryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+template size_t aesniGcmEncryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+template size_t aesniGcmEncryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+template size_t aesniGcmDecryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+template size_t aesniGcmDecryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+template size_t aesniGcmDecryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef LIBAES_BACKENDS_H
+#define LIBAES_BACKENDS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "libAES.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIBAES_X86
+#endif
+
+// CPU features relevant to backend selection, see libAES_cpu.cpp
+struct cpuFeatureSet
+{
+    bool ssse3;
+    bool pclmul;
+    bool sse41;
+    bool aesni;
+    bool avx2;    // also requires the OS to save ymm state
+    bool avx512f; // also requires the OS to save zmm state
+    bool vaes;    // also requires AVX2 or AVX512F for a wide kernel
+    bool vpclmul; // VPCLMULQDQ with AVX2
+};
+
+const cpuFeatureSet& cpuFeatures();
+
+// Block cipher backends behind aesEncrypt/aesDecrypt and encryptBlocks/
+// decryptBlocks. They work on one block or a run of independent blocks and
+// may be called with in == out. The templates take
+// the round count (10, 12 or 14) so their round loops unroll, and are
+// instantiated for all three in their source files. expandKey picks one per
+// key, see aesKeySchedule.
+
+// T-table backend, see libAES_ttable.cpp
+template<int Rounds> void ttableEncrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template<int Rounds> void ttableDecrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template<int Rounds> void ttableEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template<int Rounds> void ttableDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+
+// bitsliced constant-time backend, see libAES_bitslice.cpp. Runs eight
+// blocks at a time, so single blocks cost as much as eight.
+void bitsliceExpandKey(const uint8_t* key, aesKeySchedule& schedule);
+template<int Rounds> void bitsliceEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template<int Rounds> void bitsliceDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+
+// portable GHASH behind ghashKey::update, see libAES_ghash.cpp. Shoup's 4
+// bit tables, filled from key.H by ghashTableInit, and the constant-time
+// integer multiply version, which only needs key.H. ghashMultiply and
+// ghashPower are constant-time field products built on the latter.
+void ghashTableInit(ghashKey& key);
+void ghashTableUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length);
+void ghashCtmulUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length);
+aesBlock ghashMultiply(const aesBlock& X, const aesBlock& Y);
+aesBlock ghashPower(const aesBlock& H, uint64_t n);
+
+#ifdef LIBAES_X86
+// AES-NI backend, see libAES_aesni.cpp. aesniExpandKey fills both the
+// encryption and the decryption round keys.
+void aesniExpandKey(const uint8_t* key, aesKeySchedule& schedule);
+template<int Rounds> void aesniEncrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template<int Rounds> void aesniDecrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template<int Rounds> void aesniEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template<int Rounds> void aesniDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+
+// SSSE3 vector permute backend, see libAES_vperm.cpp. Constant-time like
+// the bitsliced backend but one block at a time, and uses its key schedule.
+template<int Rounds> void vpermEncrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template<int Rounds> void vpermDecrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+
+// VAES backend, see libAES_vaes.cpp. Uses the AES-NI key schedule and runs
+// 512 bit wide with AVX512F, 256 bit wide otherwise.
+template<int Rounds> void vaesEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template<int Rounds> void vaesDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+
+// carry-less multiply GHASH, see libAES_pclmul.cpp. ghashPclmulInit fills
+// key.clmulPowers from key.H, both updates use them.
+void ghashPclmulInit(ghashKey& key);
+void ghashPclmulUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length);
+void ghashVpclmulUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length);
+
+// stitched AES-NI and PCLMULQDQ GCM, see libAES_aesni_gcm.cpp. En/decrypts
+// and hashes whole passes of eight blocks from in to out (in may equal
+// out), advancing the counter
+// block and the hash, and returns how many blocks it did; the caller
+// finishes the rest.
+typedef size_t (*gcmBlocksFunction)(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+template<int Rounds> size_t aesniGcmEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+template<int Rounds> size_t aesniGcmDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, aesBlock& counter, aesBlock& hash, const aesKeySchedule& schedule, const ghashKey& key);
+#endif
+
+// mode pieces shared by the whole message modes and the stream contexts,
+// see libAES.cpp. Each works on one range, in may equal out; current_iv is
+// the cipher block before it, num the counter of its first block.
+void cbcDecryptRange(const aesKeySchedule& schedule, aesBlock current_iv, const uint8_t* in, uint8_t* out, size_t blocks);
+void cfbDecryptRange(const aesKeySchedule& schedule, aesBlock current_iv, const uint8_t* in, uint8_t* out, size_t data_length);
+void ctrRange(const aesKeySchedule& schedule, aesBlock nonce_counter_saver, uint32_t num, const uint8_t* in, uint8_t* out, size_t data_length);
+
+// GCM pieces shared by aesGCM and aesGCMContext, see libAES.cpp. gcmRange
+// en/decrypts a range from in to out (in may equal out) from the counter
+// block of its first block
+// and hashes its ciphertext into hash, zero padding a short last block.
+aesBlock gcmPreCounter(const ghashKey& H, const vector<uint8_t>& iv, const vector<uint8_t>& counter);
+void gcmCounterAdd(aesBlock& counter, uint64_t n);
+void gcmCheckTag(const vector<uint8_t>& tag, const vector<uint8_t>& expected_tag);
+void gcmRange(const aesKeySchedule& schedule, const ghashKey& H, aesBlock counter, aesBlock& hash, const uint8_t* in, uint8_t* out, uint64_t data_length, int enc_dec);
+
+#endif
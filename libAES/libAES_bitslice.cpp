@@ -0,0 +1,538 @@
+#include <stdint.h>
+#include <string.h>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+// Bitsliced constant-time AES, eight blocks at a time.
+//
+// The state is stored as eight bit planes: plane b holds bit b of every
+// state byte of all eight blocks. Each plane is 128 bits wide and split in
+// two 64 bit halves (state bytes 0-7 and 8-15). Inside a half, byte p
+// belongs to state byte p and its bit n belongs to block n. SubBytes is
+// computed as a boolean circuit, ShiftRows and MixColumns become shifts and
+// masks, so no memory access or branch ever depends on key or data.
+
+typedef uint64_t bitPlanes[8];
+
+
+// little endian, compilers turn these into a single load or store
+static uint64_t loadHalf(const uint8_t* bytes)
+{
+    uint64_t x = 0;
+    for(int i = 0; i < 8; i++)
+        x |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    return x;
+}
+
+
+static void storeHalf(uint8_t* bytes, uint64_t x)
+{
+    for(int i = 0; i < 8; i++)
+        bytes[i] = static_cast<uint8_t>(x >> (8 * i));
+}
+
+
+// exchange the bits of a under mask << shift with the bits of b under mask
+static void swapMove(uint64_t& a, uint64_t& b, uint64_t mask, int shift)
+{
+    uint64_t t = ((a >> shift) ^ b) & mask;
+    b ^= t;
+    a ^= t << shift;
+}
+
+
+// inside every byte position, bit i of word n swaps with bit n of word i.
+// Word n holding half a block n becomes plane n, and back again
+static void transpose(bitPlanes w)
+{
+    swapMove(w[0], w[1], 0x5555555555555555ULL, 1);
+    swapMove(w[2], w[3], 0x5555555555555555ULL, 1);
+    swapMove(w[4], w[5], 0x5555555555555555ULL, 1);
+    swapMove(w[6], w[7], 0x5555555555555555ULL, 1);
+    swapMove(w[0], w[2], 0x3333333333333333ULL, 2);
+    swapMove(w[1], w[3], 0x3333333333333333ULL, 2);
+    swapMove(w[4], w[6], 0x3333333333333333ULL, 2);
+    swapMove(w[5], w[7], 0x3333333333333333ULL, 2);
+    swapMove(w[0], w[4], 0x0F0F0F0F0F0F0F0FULL, 4);
+    swapMove(w[1], w[5], 0x0F0F0F0F0F0F0F0FULL, 4);
+    swapMove(w[2], w[6], 0x0F0F0F0F0F0F0F0FULL, 4);
+    swapMove(w[3], w[7], 0x0F0F0F0F0F0F0F0FULL, 4);
+}
+
+
+// missing blocks of a short run are zero and never stored
+static void loadBlocks(const uint8_t* in, size_t blocks, bitPlanes state[2])
+{
+    for(int h = 0; h < 2; h++)
+    {
+        for(size_t n = 0; n < 8; n++)
+            state[h][n] = (n < blocks) ? loadHalf(in + (n * 16) + (h * 8)) : 0;
+        transpose(state[h]);
+    }
+}
+
+
+static void storeBlocks(bitPlanes state[2], size_t blocks, uint8_t* out)
+{
+    for(int h = 0; h < 2; h++)
+    {
+        transpose(state[h]);
+        for(size_t n = 0; n < blocks; n++)
+            storeHalf(out + (n * 16) + (h * 8), state[h][n]);
+    }
+}
+
+
+// the round key is the same in every block, so each of its bits becomes a
+// full byte mask. Done once per call for all rounds
+static void sliceRoundKeys(const uint8_t* roundKeys, int count, bitPlanes keys[][2])
+{
+    for(int round = 0; round < count; round++)
+        for(int h = 0; h < 2; h++)
+        {
+            uint64_t half = loadHalf(roundKeys + (round * 16) + (h * 8));
+            for(int b = 0; b < 8; b++)
+                keys[round][h][b] = ((half >> b) & 0x0101010101010101ULL) * 0xff;
+        }
+}
+
+
+static void addRoundKey(bitPlanes state[2], const bitPlanes key[2])
+{
+    for(int h = 0; h < 2; h++)
+        for(int b = 0; b < 8; b++)
+            state[h][b] ^= key[h][b];
+}
+
+
+// Boyar-Peralta S-box circuit (113 gates): inversion and affine map in one
+static void sboxCircuit(bitPlanes q)
+{
+    uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    uint64_t y20, y21;
+    uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+    uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+    uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    // top linear transformation
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    // non-linear section
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    // bottom linear transformation
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+
+static void subBytes(bitPlanes state[2])
+{
+    sboxCircuit(state[0]);
+    sboxCircuit(state[1]);
+}
+
+
+// inverse affine map, including the 0x05 constant
+static void affineInv(bitPlanes q)
+{
+    uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+
+    q[0] = ~(q2 ^ q5 ^ q7);
+    q[1] = q3 ^ q6 ^ q0;
+    q[2] = ~(q4 ^ q7 ^ q1);
+    q[3] = q5 ^ q0 ^ q2;
+    q[4] = q6 ^ q1 ^ q3;
+    q[5] = q7 ^ q2 ^ q4;
+    q[6] = q0 ^ q3 ^ q5;
+    q[7] = q1 ^ q4 ^ q6;
+}
+
+
+// S is the affine map A after inversion, so inversion alone is
+// A^-1(S(A^-1(x))). The two affine maps add 36 gates to the 113 of the
+// forward circuit, about a third more than SubBytes; with a dedicated
+// inverse circuit decryption could run at encryption speed
+static void subBytesInv(bitPlanes state[2])
+{
+    for(int h = 0; h < 2; h++)
+    {
+        affineInv(state[h]);
+        sboxCircuit(state[h]);
+        affineInv(state[h]);
+    }
+}
+
+
+// row r of the state moves r columns left, a rotation of the 128 bit plane
+// (lo, hi) down by 32 * r bits. by32 is that rotation by one column, the
+// opposite one is by32 with its halves swapped
+static void shiftRows(bitPlanes state[2])
+{
+    const uint64_t row0 = 0x000000ff000000ffULL;
+
+    for(int b = 0; b < 8; b++)
+    {
+        uint64_t lo = state[0][b];
+        uint64_t hi = state[1][b];
+        uint64_t by32_lo = (lo >> 32) | (hi << 32);
+        uint64_t by32_hi = (hi >> 32) | (lo << 32);
+        state[0][b] = (lo & row0) | (by32_lo & (row0 << 8)) | (hi & (row0 << 16)) | (by32_hi & (row0 << 24));
+        state[1][b] = (hi & row0) | (by32_hi & (row0 << 8)) | (lo & (row0 << 16)) | (by32_lo & (row0 << 24));
+    }
+}
+
+
+// the same with rows 1 and 3 swapped, row r moves r columns right
+static void shiftRowsInv(bitPlanes state[2])
+{
+    const uint64_t row0 = 0x000000ff000000ffULL;
+
+    for(int b = 0; b < 8; b++)
+    {
+        uint64_t lo = state[0][b];
+        uint64_t hi = state[1][b];
+        uint64_t by32_lo = (lo >> 32) | (hi << 32);
+        uint64_t by32_hi = (hi >> 32) | (lo << 32);
+        state[0][b] = (lo & row0) | (by32_hi & (row0 << 8)) | (hi & (row0 << 16)) | (by32_lo & (row0 << 24));
+        state[1][b] = (hi & row0) | (by32_lo & (row0 << 8)) | (lo & (row0 << 16)) | (by32_hi & (row0 << 24));
+    }
+}
+
+
+// move every byte one row up (rot1) or two rows up (rot2) within its column
+static uint64_t rot1(uint64_t x)
+{
+    return ((x >> 8) & 0x00ffffff00ffffffULL) | ((x << 24) & 0xff000000ff000000ULL);
+}
+
+
+static uint64_t rot2(uint64_t x)
+{
+    return ((x >> 16) & 0x0000ffff0000ffffULL) | ((x << 16) & 0xffff0000ffff0000ULL);
+}
+
+
+// multiply every byte by x: a shift of the bit planes plus 0x1b where bit 7 was set
+static void xtime(const bitPlanes in, bitPlanes out)
+{
+    uint64_t high = in[7];
+    out[7] = in[6];
+    out[6] = in[5];
+    out[5] = in[4];
+    out[4] = in[3] ^ high;
+    out[3] = in[2] ^ high;
+    out[2] = in[1];
+    out[1] = in[0] ^ high;
+    out[0] = high;
+}
+
+
+static void mixColumns(bitPlanes state[2])
+{
+    bitPlanes r1, t, xt;
+    for(int h = 0; h < 2; h++)
+    {
+        // out_r = 2(a_r ^ a_r+1) ^ a_r+1 ^ a_r+2 ^ a_r+3
+        for(int b = 0; b < 8; b++)
+        {
+            r1[b] = rot1(state[h][b]);
+            t[b] = state[h][b] ^ r1[b];
+        }
+        xtime(t, xt);
+        for(int b = 0; b < 8; b++)
+            state[h][b] = xt[b] ^ r1[b] ^ rot2(t[b]);
+    }
+}
+
+
+static void mixColumnsInv(bitPlanes state[2])
+{
+    // InvMixColumns is MixColumns after adding 4(a_r ^ a_r+2) to every byte
+    bitPlanes t, t4;
+    for(int h = 0; h < 2; h++)
+    {
+        for(int b = 0; b < 8; b++)
+            t[b] = state[h][b] ^ rot2(state[h][b]);
+        xtime(t, t4);
+        xtime(t4, t);
+        for(int b = 0; b < 8; b++)
+            state[h][b] ^= t[b];
+    }
+    mixColumns(state);
+}
+
+
+// constant-time GF(2^8) multiply for the scalar key schedule
+static uint8_t ctMultiply(uint8_t a, uint8_t b)
+{
+    uint8_t product = 0;
+    for(int i = 0; i < 8; i++)
+    {
+        product ^= static_cast<uint8_t>(-(b & 1)) & a;
+        b >>= 1;
+        a = (a << 1) ^ (static_cast<uint8_t>(-(a >> 7)) & 0x1b);
+    }
+    return product;
+}
+
+
+static uint8_t ctSubByte(uint8_t x)
+{
+    uint8_t x2 = ctMultiply(x, x);
+    uint8_t x3 = ctMultiply(x2, x);
+    uint8_t x12 = ctMultiply(ctMultiply(x3, x3), ctMultiply(x3, x3));
+    uint8_t t = ctMultiply(x12, x3);  // x^15
+    t = ctMultiply(t, t);
+    t = ctMultiply(t, t);
+    t = ctMultiply(t, t);
+    t = ctMultiply(t, t);              // x^240
+    t = ctMultiply(ctMultiply(t, x12), x2);
+
+    uint8_t s = t;
+    for(int i = 1; i < 5; i++)
+        s ^= static_cast<uint8_t>((t << i) | (t >> (8 - i)));
+    return s ^ 0x63;
+}
+
+
+void bitsliceExpandKey(const uint8_t* key, aesKeySchedule& schedule)
+{
+    int key_words = schedule.rounds - 6; // 4, 6 or 8
+    int total_words = 4 * (schedule.rounds + 1);
+    uint8_t temp[4];
+    uint8_t front;
+
+    memcpy(schedule.roundKeys, key, key_words * 4);
+
+    for(int i = key_words; i < total_words; i++)
+    {
+        for(int j = 0; j < 4; j++)
+            temp[j] = schedule.roundKeys[(i - 1) * 4 + j];
+
+        if(i % key_words == 0)
+        {
+            front = temp[0];
+            temp[0] = ctSubByte(temp[1]) ^ AES_TABLES.rcon[i / key_words - 1];
+            temp[1] = ctSubByte(temp[2]);
+            temp[2] = ctSubByte(temp[3]);
+            temp[3] = ctSubByte(front);
+        }
+        else if(key_words == 8 && i % key_words == 4)
+        {
+            for(int j = 0; j < 4; j++)
+                temp[j] = ctSubByte(temp[j]);
+        }
+
+        for(int j = 0; j < 4; j++)
+            schedule.roundKeys[i * 4 + j] = schedule.roundKeys[(i - key_words) * 4 + j] ^ temp[j];
+    }
+}
+
+
+template<int Rounds>
+void bitsliceEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    bitPlanes keys[Rounds + 1][2];
+    bitPlanes state[2];
+
+    sliceRoundKeys(schedule.roundKeys, Rounds + 1, keys);
+
+    for(size_t i = 0; i < blocks; i += 8)
+    {
+        size_t count = (blocks - i < 8) ? blocks - i : 8;
+        loadBlocks(in + (i * 16), count, state);
+
+        addRoundKey(state, keys[0]);
+        for(int round = 1; round < Rounds; round++)
+        {
+            subBytes(state);
+            shiftRows(state);
+            mixColumns(state);
+            addRoundKey(state, keys[round]);
+        }
+        subBytes(state);
+        shiftRows(state);
+        addRoundKey(state, keys[Rounds]);
+
+        storeBlocks(state, count, out + (i * 16));
+    }
+}
+
+
+template<int Rounds>
+void bitsliceDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    bitPlanes keys[Rounds + 1][2];
+    bitPlanes state[2];
+
+    sliceRoundKeys(schedule.roundKeys, Rounds + 1, keys);
+
+    for(size_t i = 0; i < blocks; i += 8)
+    {
+        size_t count = (blocks - i < 8) ? blocks - i : 8;
+        loadBlocks(in + (i * 16), count, state);
+
+        addRoundKey(state, keys[Rounds]);
+        for(int round = Rounds - 1; round > 0; round--)
+        {
+            shiftRowsInv(state);
+            subBytesInv(state);
+            addRoundKey(state, keys[round]);
+            mixColumnsInv(state);
+        }
+        shiftRowsInv(state);
+        subBytesInv(state);
+        addRoundKey(state, keys[0]);
+
+        storeBlocks(state, count, out + (i * 16));
+    }
+}
+
+template void bitsliceEncryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void bitsliceEncryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void bitsliceEncryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void bitsliceDecryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void bitsliceDecryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void bitsliceDecryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
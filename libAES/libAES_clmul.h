@@ -0,0 +1,66 @@
+#ifndef LIBAES_CLMUL_H
+#define LIBAES_CLMUL_H
+
+#include <immintrin.h>
+
+// Carry-less multiply helpers shared by the PCLMULQDQ GHASH and the stitched
+// GCM kernel. Field elements are byte reversed blocks, see libAES_pclmul.cpp.
+
+#define PCLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+
+PCLMUL_TARGET static inline __m128i byteSwap(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+
+// adds a * b to the unreduced sum low + mid * x^64 + high * x^128
+PCLMUL_TARGET static inline void clmulAccumulate(__m128i a, __m128i b, __m128i& low, __m128i& mid, __m128i& high)
+{
+    low = _mm_xor_si128(low, _mm_clmulepi64_si128(a, b, 0x00));
+    high = _mm_xor_si128(high, _mm_clmulepi64_si128(a, b, 0x11));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+}
+
+
+// shifts the 256 bit sum left one bit and reduces it modulo
+// x^128 + x^7 + x^2 + x + 1
+PCLMUL_TARGET static inline __m128i clmulReduce(__m128i low, __m128i mid, __m128i high)
+{
+    low = _mm_xor_si128(low, _mm_slli_si128(mid, 8));
+    high = _mm_xor_si128(high, _mm_srli_si128(mid, 8));
+
+    // 256 bit shift left by one
+    __m128i low_carry = _mm_srli_epi32(low, 31);
+    __m128i high_carry = _mm_srli_epi32(high, 31);
+    low = _mm_slli_epi32(low, 1);
+    high = _mm_slli_epi32(high, 1);
+    __m128i across = _mm_srli_si128(low_carry, 12);
+    low = _mm_or_si128(low, _mm_slli_si128(low_carry, 4));
+    high = _mm_or_si128(high, _mm_slli_si128(high_carry, 4));
+    high = _mm_or_si128(high, across);
+
+    // first phase of the reduction
+    __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30)), _mm_slli_epi32(low, 25));
+    __m128i t_high = _mm_srli_si128(t, 4);
+    low = _mm_xor_si128(low, _mm_slli_si128(t, 12));
+
+    // second phase
+    __m128i u = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2)), _mm_srli_epi32(low, 7));
+    u = _mm_xor_si128(u, t_high);
+    low = _mm_xor_si128(low, u);
+    return _mm_xor_si128(high, low);
+}
+
+
+PCLMUL_TARGET static inline __m128i clmulMult(__m128i a, __m128i b)
+{
+    __m128i low = _mm_setzero_si128();
+    __m128i mid = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+    clmulAccumulate(a, b, low, mid, high);
+    return clmulReduce(low, mid, high);
+}
+
+#endif
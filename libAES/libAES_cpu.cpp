@@ -0,0 +1,63 @@
+#include "libAES_backends.h"
+
+#ifdef LIBAES_X86
+#include <cpuid.h>
+#endif
+
+// Runtime CPU feature detection, done once and cached.
+
+#ifdef LIBAES_X86
+// XCR0 tells us which register files the OS saves on a context switch
+static uint64_t readXcr0()
+{
+    uint32_t low, high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+#endif
+
+
+static cpuFeatureSet detectCpuFeatures()
+{
+    cpuFeatureSet features = {};
+
+#ifdef LIBAES_X86
+    unsigned int eax, ebx, ecx, edx;
+    bool ymm_enabled = false;
+    bool zmm_enabled = false;
+
+    if(__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        features.pclmul = (ecx >> 1) & 1;
+        features.ssse3 = (ecx >> 9) & 1;
+        features.sse41 = (ecx >> 19) & 1;
+        features.aesni = (ecx >> 25) & 1;
+
+        if(((ecx >> 27) & 1) && ((ecx >> 28) & 1)) // OSXSAVE and AVX
+        {
+            uint64_t xcr0 = readXcr0();
+            ymm_enabled = (xcr0 & 0x06) == 0x06;
+            zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+        }
+    }
+
+    if(ymm_enabled && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        features.avx2 = (ebx >> 5) & 1;
+        features.avx512f = zmm_enabled && ((ebx >> 16) & 1);
+        // the VAES kernels are ymm with AVX2 or zmm with AVX512F, a VAES bit
+        // without either (AVX2 masked off in a VM) is not usable
+        features.vaes = features.aesni && (features.avx2 || features.avx512f) && ((ecx >> 9) & 1);
+        features.vpclmul = features.avx2 && features.pclmul && ((ecx >> 10) & 1);
+    }
+#endif
+
+    return features;
+}
+
+
+const cpuFeatureSet& cpuFeatures()
+{
+    static const cpuFeatureSet features = detectCpuFeatures();
+    return features;
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <stdexcept>
+#include "libAES_gcm.h"
+#include "libAES_backends.h"
+
+using namespace std;
+
+
+void aesGCMContext::init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter)
+{
+    libAES aes;
+    init(aes.expandKey(key), iv, enc_dec, counter);
+}
+
+
+void aesGCMContext::init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter)
+{
+    libAES aes;
+    this->schedule = schedule;
+    H = aes.expandGhashKey(schedule);
+    encDec = enc_dec;
+
+    this->counter = gcmPreCounter(H, iv, counter);
+    encNonce = this->counter;
+    schedule.encryptBlock(encNonce.bytes, encNonce.bytes, schedule);
+    gcmCounterAdd(this->counter, 1);
+
+    GHASH = {};
+    AADLength = 0;
+    dataLength = 0;
+    partialLength = 0;
+    ready = true;
+    dataStarted = false;
+}
+
+
+void aesGCMContext::updateAAD(const uint8_t* data, size_t length)
+{
+    if(!ready)
+        throw runtime_error("GCM context not initialized");
+    if(dataStarted)
+        throw runtime_error("GCM AAD must come before the data");
+    AADLength += length;
+
+    // top up a short block from the last call
+    size_t done = 0;
+    if(partialLength != 0)
+    {
+        done = min(16 - partialLength, length);
+        copy(data, data + done, partial.bytes + partialLength);
+        partialLength += done;
+        if(partialLength < 16)
+            return;
+        H.update(GHASH, H, partial.bytes, 16);
+        partialLength = 0;
+    }
+
+    size_t whole = (length - done) & ~static_cast<size_t>(15);
+    H.update(GHASH, H, data + done, whole);
+    done += whole;
+
+    partialLength = length - done;
+    copy(data + done, data + length, partial.bytes);
+}
+
+
+void aesGCMContext::updateAAD(const vector<uint8_t>& AAD)
+{
+    updateAAD(AAD.data(), AAD.size());
+}
+
+
+// AAD is zero padded for authentication
+void aesGCMContext::finishAAD()
+{
+    if(partialLength != 0)
+        H.update(GHASH, H, partial.bytes, partialLength);
+    partialLength = 0;
+    dataStarted = true;
+}
+
+
+void aesGCMContext::update(const uint8_t* in, uint8_t* out, size_t length)
+{
+    if(!ready)
+        throw runtime_error("GCM context not initialized");
+    if(!dataStarted)
+        finishAAD();
+    dataLength += length;
+
+    size_t done = 0;
+    while(done < length)
+    {
+        // whole blocks go through the same code as aesGCM
+        if(partialLength == 0 && length - done >= 16)
+        {
+            size_t blocks = (length - done) / 16;
+            gcmRange(schedule, H, counter, GHASH, in + done, out + done, blocks * 16, encDec);
+            gcmCounterAdd(counter, blocks);
+            done += blocks * 16;
+            continue;
+        }
+
+        // a short block is kept with its keystream until the next call
+        // fills it, only full blocks are hashed before the end
+        if(partialLength == 0)
+        {
+            schedule.encryptBlock(counter.bytes, keystream.bytes, schedule);
+            gcmCounterAdd(counter, 1);
+        }
+        size_t take = min(16 - partialLength, length - done);
+        for(size_t i = 0; i < take; i++)
+        {
+            uint8_t text = in[done + i];
+            out[done + i] = text ^ keystream[partialLength + i];
+            partial[partialLength + i] = encDec ? text : out[done + i];
+        }
+        partialLength += take;
+        done += take;
+
+        if(partialLength == 16)
+        {
+            H.update(GHASH, H, partial.bytes, 16);
+            partialLength = 0;
+        }
+    }
+}
+
+
+void aesGCMContext::update(vector<uint8_t>& binaryData)
+{
+    update(binaryData.data(), binaryData.data(), binaryData.size());
+}
+
+
+// hashes the short block and the lengths and returns the tag
+vector<uint8_t> aesGCMContext::finish()
+{
+    if(!ready)
+        throw runtime_error("GCM context not initialized");
+    if(!dataStarted)
+        finishAAD();
+    if(partialLength != 0)
+        H.update(GHASH, H, partial.bytes, partialLength);
+
+    // handle length verification
+    aesBlock length_block;
+    for (int i = 0; i < 8; i++)
+        length_block[i] = (AADLength * 8) >> (56 - 8 * i);
+    for (int i = 0; i < 8; i++)
+        length_block[8 + i] = (dataLength * 8) >> (56 - 8 * i);
+    H.update(GHASH, H, length_block.bytes, 16);
+    libAES::addRoundKey(GHASH, encNonce.bytes);
+
+    ready = false;
+    return vector<uint8_t>(GHASH.bytes, GHASH.bytes + 16);
+}
+
+
+vector<uint8_t> aesGCMContext::finalEncrypt()
+{
+    return finish();
+}
+
+
+void aesGCMContext::finalVerify(const vector<uint8_t>& expected_tag)
+{
+    gcmCheckTag(finish(), expected_tag);
+}
@@ -0,0 +1,53 @@
+#ifndef LIBAES_GCM_H
+#define LIBAES_GCM_H
+
+#include "libAES.h"
+
+// GCM for one message fed in pieces, in constant memory. Call init, then
+// updateAAD any number of times, then update any number of times with
+// chunks of any length, then finalEncrypt for the tag or finalVerify to
+// check it. Gives the same output and tag as aesGCM on the whole message.
+// Decrypted data is only authentic once finalVerify returns.
+class aesGCMContext
+{
+    public:
+        void init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter = {0, 0, 0, 1});
+        void init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter = {0, 0, 0, 1});
+
+        // additional authenticated data, all of it before the first update
+        void updateAAD(const uint8_t* data, size_t length);
+        void updateAAD(const vector<uint8_t>& AAD);
+
+        // en/decrypts length bytes from in to out, in may equal out
+        void update(const uint8_t* in, uint8_t* out, size_t length);
+        void update(vector<uint8_t>& binaryData);
+
+        // end the message, init starts the next one
+        vector<uint8_t> finalEncrypt();
+        void finalVerify(const vector<uint8_t>& expected_tag);
+
+    private:
+        vector<uint8_t> finish();
+        void finishAAD();
+
+        aesKeySchedule schedule;
+        ghashKey H;
+        int encDec = 0;
+
+        aesBlock counter;  // counter block of the next block of keystream
+        aesBlock encNonce; // E(K, J0), masks the tag
+        aesBlock GHASH;
+        uint64_t AADLength = 0;
+        uint64_t dataLength = 0;
+
+        // a block left short by the last call, its keystream and its
+        // ciphertext so far, for the data and then the AAD
+        aesBlock keystream;
+        aesBlock partial;
+        size_t partialLength = 0;
+
+        bool ready = false;       // init done and no final yet
+        bool dataStarted = false; // AAD is closed
+};
+
+#endif
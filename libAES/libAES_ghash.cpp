@@ -0,0 +1,255 @@
+#include <stdint.h>
+#include <algorithm>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+using namespace std;
+
+// Portable GHASH. GCM stores field elements bit reflected, x^0 is the top bit
+// of byte 0, so multiplying by x is a right shift.
+//
+// ghashTable* is Shoup's 4 bit method. The table holds i * H for every nibble
+// i, and X * H is built a nibble at a time from the end of X: Z = Z * x^4 +
+// nibble * H, folding the four bits shifted out of Z back in with
+// ghashReduce4. The lookups are indexed by the data, so it is only used with
+// the T-table block cipher, which leaks the same way.
+//
+// ghashCtmul* is constant-time, after BearSSL's ghash_ctmul64: carry-less
+// products come from ordinary integer multiplies of operands masked to every
+// fourth bit, so carries land in bits that are masked off again.
+
+// the four bits shifted out of the low end times x^128 mod the GCM polynomial,
+// as the top 16 bits of the high word
+static const uint16_t ghashReduce4[16] =
+{
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+
+static uint64_t loadBig64(const uint8_t* in)
+{
+    uint64_t word = 0;
+    for(int i = 0; i < 8; i++)
+        word = (word << 8) | in[i];
+    return word;
+}
+
+
+static void storeBig64(uint64_t word, uint8_t* out)
+{
+    for(int i = 7; i >= 0; i--)
+    {
+        out[i] = static_cast<uint8_t>(word);
+        word >>= 8;
+    }
+}
+
+
+void ghashTableInit(ghashKey& key)
+{
+    uint64_t high = loadBig64(key.H.bytes);
+    uint64_t low = loadBig64(key.H.bytes + 8);
+
+    // H sits at index 8 because the top bit of a nibble is the lowest power
+    key.tableHigh[0] = 0;
+    key.tableLow[0] = 0;
+    key.tableHigh[8] = high;
+    key.tableLow[8] = low;
+
+    // H * x, H * x^2, H * x^3 at 4, 2, 1, reduced with a mask instead of a
+    // branch on H
+    for(int i = 4; i > 0; i >>= 1)
+    {
+        uint64_t reduce = (0 - (low & 1)) & 0xe100000000000000;
+        low = (high << 63) | (low >> 1);
+        high = (high >> 1) ^ reduce;
+        key.tableHigh[i] = high;
+        key.tableLow[i] = low;
+    }
+
+    // the rest are sums of those
+    for(int i = 2; i <= 8; i *= 2)
+    {
+        for(int j = 1; j < i; j++)
+        {
+            key.tableHigh[i + j] = key.tableHigh[i] ^ key.tableHigh[j];
+            key.tableLow[i + j] = key.tableLow[i] ^ key.tableLow[j];
+        }
+    }
+}
+
+
+// X = X * H, X as its big endian halves
+static void ghashTableMult(uint64_t& high, uint64_t& low, const ghashKey& key)
+{
+    uint64_t z_high = 0;
+    uint64_t z_low = 0;
+
+    for(int i = 0; i < 32; i++)
+    {
+        uint64_t word = (i < 16) ? low : high;
+        int nibble = (word >> ((i % 16) * 4)) & 0xf;
+        int shifted_out = z_low & 0xf;
+
+        z_low = (z_high << 60) | (z_low >> 4);
+        z_high = (z_high >> 4) ^ (static_cast<uint64_t>(ghashReduce4[shifted_out]) << 48);
+        z_high ^= key.tableHigh[nibble];
+        z_low ^= key.tableLow[nibble];
+    }
+
+    high = z_high;
+    low = z_low;
+}
+
+
+void ghashTableUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length)
+{
+    uint64_t high = loadBig64(state.bytes);
+    uint64_t low = loadBig64(state.bytes + 8);
+
+    for(size_t i = 0; i < length; i += 16)
+    {
+        // the last partial block is zero padded
+        aesBlock block = {};
+        copy(data + i, data + i + min<size_t>(16, length - i), block.bytes);
+
+        high ^= loadBig64(block.bytes);
+        low ^= loadBig64(block.bytes + 8);
+        ghashTableMult(high, low, key);
+    }
+
+    storeBig64(high, state.bytes);
+    storeBig64(low, state.bytes + 8);
+}
+
+
+// carry-less 64 x 64 bit multiply, low 64 bits of the product. Each masked
+// operand has a one at most every fourth bit, so at most 16 ones add up in
+// any position and only the top one can carry, out of the word.
+static uint64_t clmulLow64(uint64_t x, uint64_t y)
+{
+    uint64_t x0 = x & 0x1111111111111111;
+    uint64_t x1 = x & 0x2222222222222222;
+    uint64_t x2 = x & 0x4444444444444444;
+    uint64_t x3 = x & 0x8888888888888888;
+    uint64_t y0 = y & 0x1111111111111111;
+    uint64_t y1 = y & 0x2222222222222222;
+    uint64_t y2 = y & 0x4444444444444444;
+    uint64_t y3 = y & 0x8888888888888888;
+
+    uint64_t z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    uint64_t z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    uint64_t z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    uint64_t z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+
+    return (z0 & 0x1111111111111111) | (z1 & 0x2222222222222222) | (z2 & 0x4444444444444444) | (z3 & 0x8888888888888888);
+}
+
+
+static uint64_t reverseBits64(uint64_t x)
+{
+    x = ((x & 0x5555555555555555) << 1) | ((x >> 1) & 0x5555555555555555);
+    x = ((x & 0x3333333333333333) << 2) | ((x >> 2) & 0x3333333333333333);
+    x = ((x & 0x0f0f0f0f0f0f0f0f) << 4) | ((x >> 4) & 0x0f0f0f0f0f0f0f0f);
+    x = ((x & 0x00ff00ff00ff00ff) << 8) | ((x >> 8) & 0x00ff00ff00ff00ff);
+    x = ((x & 0x0000ffff0000ffff) << 16) | ((x >> 16) & 0x0000ffff0000ffff);
+    return (x << 32) | (x >> 32);
+}
+
+
+void ghashCtmulUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length)
+{
+    // halves as integers, high is the first 8 bytes
+    uint64_t y_high = loadBig64(state.bytes);
+    uint64_t y_low = loadBig64(state.bytes + 8);
+    uint64_t h_high = loadBig64(key.H.bytes);
+    uint64_t h_low = loadBig64(key.H.bytes + 8);
+
+    // the high halves of the 64 bit products come from the bit reversed
+    // operands, and Karatsuba needs the sums of the halves
+    uint64_t h_high_rev = reverseBits64(h_high);
+    uint64_t h_low_rev = reverseBits64(h_low);
+    uint64_t h_sum = h_high ^ h_low;
+    uint64_t h_sum_rev = h_high_rev ^ h_low_rev;
+
+    for(size_t i = 0; i < length; i += 16)
+    {
+        // the last partial block is zero padded
+        aesBlock block = {};
+        copy(data + i, data + i + min<size_t>(16, length - i), block.bytes);
+        y_high ^= loadBig64(block.bytes);
+        y_low ^= loadBig64(block.bytes + 8);
+
+        uint64_t y_high_rev = reverseBits64(y_high);
+        uint64_t y_low_rev = reverseBits64(y_low);
+        uint64_t y_sum = y_high ^ y_low;
+        uint64_t y_sum_rev = y_high_rev ^ y_low_rev;
+
+        // Karatsuba: three 128 bit products, each as its low and high word
+        uint64_t low = clmulLow64(y_low, h_low);
+        uint64_t high = clmulLow64(y_high, h_high);
+        uint64_t mid = clmulLow64(y_sum, h_sum);
+        uint64_t low_top = clmulLow64(y_low_rev, h_low_rev);
+        uint64_t high_top = clmulLow64(y_high_rev, h_high_rev);
+        uint64_t mid_top = clmulLow64(y_sum_rev, h_sum_rev);
+        mid ^= low ^ high;
+        mid_top ^= low_top ^ high_top;
+        low_top = reverseBits64(low_top) >> 1;
+        high_top = reverseBits64(high_top) >> 1;
+        mid_top = reverseBits64(mid_top) >> 1;
+
+        // the 256 bit product, v0 lowest
+        uint64_t v0 = low;
+        uint64_t v1 = low_top ^ mid;
+        uint64_t v2 = high ^ mid_top;
+        uint64_t v3 = high_top;
+
+        // bit reflected, so the product is one bit short
+        v3 = (v3 << 1) | (v2 >> 63);
+        v2 = (v2 << 1) | (v1 >> 63);
+        v1 = (v1 << 1) | (v0 >> 63);
+        v0 = (v0 << 1);
+
+        // reduce modulo x^128 + x^7 + x^2 + x + 1
+        v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+        v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+        v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+        v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+        y_low = v2;
+        y_high = v3;
+    }
+
+    storeBig64(y_high, state.bytes);
+    storeBig64(y_low, state.bytes + 8);
+}
+
+
+// X * Y, constant-time: hashing a zero block into state X under key Y
+aesBlock ghashMultiply(const aesBlock& X, const aesBlock& Y)
+{
+    static const uint8_t zero[16] = {};
+    ghashKey key;
+    key.H = Y;
+    aesBlock product = X;
+    ghashCtmulUpdate(product, key, zero, 16);
+    return product;
+}
+
+
+// H^n by square and multiply, n is public and H stays secret
+aesBlock ghashPower(const aesBlock& H, uint64_t n)
+{
+    aesBlock square = H;
+    aesBlock result = {};
+    result[0] = 0x80; // the field's 1, bit reflected
+
+    for(; n != 0; n >>= 1)
+    {
+        if(n & 1)
+            result = ghashMultiply(result, square);
+        square = ghashMultiply(square, square);
+    }
+    return result;
+}
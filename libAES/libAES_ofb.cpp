@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <stdexcept>
+#include "libAES_ofb.h"
+
+using namespace std;
+
+// blocks made per lock round trip, OFB itself is one block at a time
+static const size_t OFB_BATCH_BLOCKS = 64;
+
+
+aesOFBKeystream::aesOFBKeystream(const aesKeySchedule& schedule, const vector<uint8_t>& iv, size_t buffer_bytes) : schedule(schedule)
+{
+    if(iv.size() != 16)
+        throw runtime_error("Invalid IV length");
+    copy(iv.begin(), iv.end(), state.bytes);
+
+    // whole blocks only, so a block never wraps around the end of the ring
+    size_t buffer_blocks = max<size_t>(OFB_BATCH_BLOCKS, (buffer_bytes + 15) / 16);
+    ring.resize(buffer_blocks * 16);
+}
+
+
+aesOFBKeystream::~aesOFBKeystream()
+{
+    stop();
+}
+
+
+void aesOFBKeystream::start()
+{
+    lock_guard<mutex> guard(stateLock);
+    if(running)
+        return;
+    running = true;
+    stopping = false;
+    worker = thread(&aesOFBKeystream::work, this);
+}
+
+
+void aesOFBKeystream::stop()
+{
+    {
+        lock_guard<mutex> guard(stateLock);
+        if(!running)
+            return;
+        stopping = true;
+    }
+    // wake the worker and any process call waiting on it
+    space.notify_all();
+    filled.notify_all();
+    worker.join();
+
+    lock_guard<mutex> guard(stateLock);
+    running = false;
+}
+
+
+// appends up to `blocks` keystream blocks to the ring if there is room and
+// returns how many, called with producerLock held
+size_t aesOFBKeystream::produce(size_t blocks)
+{
+    uint64_t write_at;
+    {
+        lock_guard<mutex> guard(stateLock);
+        size_t free_bytes = ring.size() - static_cast<size_t>(writeHead - readHead);
+        blocks = min(blocks, free_bytes / 16);
+        write_at = writeHead;
+    }
+    if(blocks == 0)
+        return 0;
+
+    // the reader never touches the free part of the ring, so it can be
+    // written without stateLock
+    for(size_t i = 0; i < blocks; i++)
+    {
+        uint8_t* out = ring.data() + ((write_at + (i * 16)) % ring.size());
+        schedule.encryptBlock(state.bytes, state.bytes, schedule);
+        copy(state.bytes, state.bytes + 16, out);
+    }
+
+    {
+        lock_guard<mutex> guard(stateLock);
+        writeHead += blocks * 16;
+    }
+    filled.notify_all();
+    return blocks;
+}
+
+
+void aesOFBKeystream::work()
+{
+    while(true)
+    {
+        {
+            unique_lock<mutex> guard(stateLock);
+            space.wait(guard, [this] { return stopping || ring.size() - (writeHead - readHead) >= 16; });
+            if(stopping)
+                return;
+        }
+
+        lock_guard<mutex> producing(producerLock);
+        produce(OFB_BATCH_BLOCKS);
+    }
+}
+
+
+void aesOFBKeystream::pregenerate(size_t bytes)
+{
+    bytes = min(bytes, ring.size());
+
+    while(true)
+    {
+        size_t ready = available();
+        if(ready >= bytes)
+            return;
+
+        // a partly read block keeps the ring from filling all the way
+        lock_guard<mutex> producing(producerLock);
+        if(produce(min(OFB_BATCH_BLOCKS, (bytes - ready + 15) / 16)) == 0)
+            return;
+    }
+}
+
+
+size_t aesOFBKeystream::available()
+{
+    lock_guard<mutex> guard(stateLock);
+    return static_cast<size_t>(writeHead - readHead);
+}
+
+
+void aesOFBKeystream::process(uint8_t* data, size_t length)
+{
+    while(length > 0)
+    {
+        uint64_t read_at;
+        size_t ready;
+        {
+            // a stop from another thread ends the wait, the worker will not
+            // fill the ring any more and the inline path below takes over
+            unique_lock<mutex> guard(stateLock);
+            if(running)
+                filled.wait(guard, [this] { return stopping || writeHead != readHead; });
+            read_at = readHead;
+            ready = static_cast<size_t>(writeHead - readHead);
+        }
+
+        if(ready == 0)
+        {
+            // nothing buffered and nobody making more, run OFB straight on
+            // the data and keep the ring empty; state ends on the last
+            // block, a short tail is kept in the ring for the next call
+            lock_guard<mutex> producing(producerLock);
+            // the worker may have made a last batch before it stopped
+            if(available() > 0)
+                continue;
+            size_t whole = length / 16;
+            for(size_t i = 0; i < whole; i++)
+            {
+                schedule.encryptBlock(state.bytes, state.bytes, schedule);
+                for(int j = 0; j < 16; j++)
+                    data[j] ^= state[j];
+                data += 16;
+            }
+            length -= whole * 16;
+            if(length > 0)
+                produce(1);
+            continue;
+        }
+
+        // the ready bytes may wrap around the end of the ring
+        size_t offset = static_cast<size_t>(read_at % ring.size());
+        size_t count = min({length, ready, ring.size() - offset});
+        const uint8_t* keystream = ring.data() + offset;
+        for(size_t j = 0; j < count; j++)
+            data[j] ^= keystream[j];
+        data += count;
+        length -= count;
+
+        {
+            lock_guard<mutex> guard(stateLock);
+            readHead += count;
+        }
+        space.notify_all();
+    }
+}
+
+
+void aesOFBKeystream::process(vector<uint8_t>& binaryData)
+{
+    process(binaryData.data(), binaryData.size());
+}
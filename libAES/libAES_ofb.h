@@ -0,0 +1,61 @@
+#ifndef LIBAES_OFB_H
+#define LIBAES_OFB_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "libAES.h"
+
+// OFB keystream for one key and IV, produced ahead of the data that uses it.
+// The keystream never depends on the data, so it can be computed on a
+// background thread (start) or on the caller's own idle time (pregenerate)
+// into a ring buffer, and process only has to xor it in. Without either it
+// works like aesOFB. One thread at a time may call process/pregenerate.
+class aesOFBKeystream
+{
+    public:
+        aesOFBKeystream(const aesKeySchedule& schedule, const vector<uint8_t>& iv, size_t buffer_bytes = 1 << 20);
+        ~aesOFBKeystream();
+
+        aesOFBKeystream(const aesOFBKeystream&) = delete;
+        aesOFBKeystream& operator=(const aesOFBKeystream&) = delete;
+
+        // keep the buffer topped up from a background thread until stop
+        void start();
+        void stop();
+
+        // fill the buffer up to `bytes` (at most its size) on the calling thread
+        void pregenerate(size_t bytes);
+
+        // bytes of keystream ready to use
+        size_t available();
+
+        // xor the next keystream bytes into data, encryption and decryption
+        // are the same. While started it waits for the worker, a stop from
+        // another thread lets it finish the data on the calling thread
+        void process(uint8_t* data, size_t length);
+        void process(vector<uint8_t>& binaryData);
+
+    private:
+        size_t produce(size_t blocks);
+        void work();
+
+        aesKeySchedule schedule;
+        aesBlock state; // last keystream block, input of the next one
+
+        // ring of whole keystream blocks, readHead/writeHead count bytes
+        // since the start and only grow
+        vector<uint8_t> ring;
+        uint64_t readHead = 0;
+        uint64_t writeHead = 0;
+
+        mutex producerLock; // whoever holds it owns state and writes the ring
+        mutex stateLock;    // guards the heads and the flags below
+        condition_variable space;
+        condition_variable filled;
+        thread worker;
+        bool running = false;
+        bool stopping = false;
+};
+
+#endif
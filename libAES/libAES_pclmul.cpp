@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <algorithm>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+#ifdef LIBAES_X86
+#include <immintrin.h>
+#include "libAES_clmul.h"
+
+// GHASH with carry-less multiplication (Intel's GCM white paper, Gueron and
+// Kounavis). Blocks are byte reversed so a field element is one 128 bit
+// integer, bit reflected, which makes every product one bit short: the shift
+// and the reduction are linear, so up to eight products by H^8 .. H^1 are
+// summed unreduced and reduced once. The VPCLMULQDQ version does two of
+// those products per instruction.
+
+#define VPCLMUL_TARGET __attribute__((target("vpclmulqdq,pclmul,avx2")))
+
+using namespace std;
+
+
+PCLMUL_TARGET void ghashPclmulInit(ghashKey& key)
+{
+    __m128i H = byteSwap(_mm_load_si128(reinterpret_cast<const __m128i*>(key.H.bytes)));
+    __m128i power = H;
+
+    for(int i = 7; i >= 0; i--)
+    {
+        _mm_store_si128(reinterpret_cast<__m128i*>(key.clmulPowers[i]), power);
+        power = clmulMult(power, H);
+    }
+}
+
+
+PCLMUL_TARGET void ghashPclmulUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length)
+{
+    __m128i x = byteSwap(_mm_load_si128(reinterpret_cast<const __m128i*>(state.bytes)));
+    size_t blocks = length / 16;
+
+    __m128i powers[8];
+    for(int i = 0; i < 8; i++)
+        powers[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(key.clmulPowers[i]));
+
+    // eight blocks per reduction, the running hash goes into the first one,
+    // which gets the highest power
+    for(; blocks >= 8; blocks -= 8, data += 128)
+    {
+        __m128i low = _mm_setzero_si128();
+        __m128i mid = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+
+#pragma GCC unroll 8
+        for(int i = 0; i < 8; i++)
+        {
+            __m128i block = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + (i * 16))));
+            if(i == 0)
+                block = _mm_xor_si128(block, x);
+            clmulAccumulate(block, powers[i], low, mid, high);
+        }
+        x = clmulReduce(low, mid, high);
+    }
+
+    // fewer than eight whole blocks left, they take the lowest powers
+    if(blocks > 0)
+    {
+        __m128i low = _mm_setzero_si128();
+        __m128i mid = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+
+        for(size_t i = 0; i < blocks; i++)
+        {
+            __m128i block = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + (i * 16))));
+            if(i == 0)
+                block = _mm_xor_si128(block, x);
+            clmulAccumulate(block, powers[8 - blocks + i], low, mid, high);
+        }
+        x = clmulReduce(low, mid, high);
+        data += blocks * 16;
+    }
+
+    // the last partial block is zero padded
+    size_t tail = length % 16;
+    if(tail != 0)
+    {
+        aesBlock last = {};
+        copy(data, data + tail, last.bytes);
+        __m128i block = byteSwap(_mm_load_si128(reinterpret_cast<const __m128i*>(last.bytes)));
+        x = clmulMult(_mm_xor_si128(block, x), powers[7]);
+    }
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(state.bytes), byteSwap(x));
+}
+
+
+VPCLMUL_TARGET void ghashVpclmulUpdate(aesBlock& state, const ghashKey& key, const uint8_t* data, size_t length)
+{
+    const __m256i swap = _mm256_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                         0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i x = byteSwap(_mm_load_si128(reinterpret_cast<const __m128i*>(state.bytes)));
+    size_t blocks = length / 16;
+
+    // H^8 H^7, H^6 H^5, ... one pair per register, lower power in the upper lane
+    __m256i powers[4];
+    for(int i = 0; i < 4; i++)
+        powers[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(key.clmulPowers[i * 2]));
+
+    for(; blocks >= 8; blocks -= 8, data += 128)
+    {
+        __m256i low = _mm256_setzero_si256();
+        __m256i mid = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+
+#pragma GCC unroll 4
+        for(int i = 0; i < 4; i++)
+        {
+            __m256i pair = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + (i * 32))), swap);
+            if(i == 0)
+                pair = _mm256_xor_si256(pair, _mm256_zextsi128_si256(x));
+            low = _mm256_xor_si256(low, _mm256_clmulepi64_epi128(pair, powers[i], 0x00));
+            high = _mm256_xor_si256(high, _mm256_clmulepi64_epi128(pair, powers[i], 0x11));
+            mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(pair, powers[i], 0x01));
+            mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(pair, powers[i], 0x10));
+        }
+
+        // add the two lanes, then one reduction for all eight
+        x = clmulReduce(_mm_xor_si128(_mm256_castsi256_si128(low), _mm256_extracti128_si256(low, 1)),
+                        _mm_xor_si128(_mm256_castsi256_si128(mid), _mm256_extracti128_si256(mid, 1)),
+                        _mm_xor_si128(_mm256_castsi256_si128(high), _mm256_extracti128_si256(high, 1)));
+    }
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(state.bytes), byteSwap(x));
+
+    // the rest
+    if(length % 128 != 0)
+        ghashPclmulUpdate(state, key, data, length % 128);
+}
+
+#endif
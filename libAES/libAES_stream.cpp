@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <stdexcept>
+#include "libAES_stream.h"
+#include "libAES_backends.h"
+
+using namespace std;
+
+
+// appends the whole blocks of buffer + in to out and keeps the rest in
+// buffer, with hold_last a last whole block is kept too; returns the number
+// of blocks appended
+static size_t gatherBlocks(aesBlock& buffer, size_t& buffered, const uint8_t* in, size_t length, vector<uint8_t>& out, bool hold_last)
+{
+    size_t total = buffered + length;
+    size_t blocks = total / 16;
+    if(hold_last && blocks != 0 && total % 16 == 0)
+        blocks--;
+
+    size_t from_in = 0;
+    if(blocks != 0)
+    {
+        size_t start = out.size();
+        out.resize(start + (blocks * 16));
+        from_in = (blocks * 16) - buffered;
+        copy(buffer.bytes, buffer.bytes + buffered, out.data() + start);
+        copy(in, in + from_in, out.data() + start + buffered);
+        buffered = 0;
+    }
+
+    copy(in + from_in, in + length, buffer.bytes + buffered);
+    buffered += length - from_in;
+    return blocks;
+}
+
+
+// PKCS#7 pads the short block in buffer to a whole one
+static void padBlock(aesBlock& buffer, size_t buffered)
+{
+    fill(buffer.bytes + buffered, buffer.bytes + 16, static_cast<uint8_t>(16 - buffered));
+}
+
+
+// appends the last decrypted block to out without its padding
+static void unpadBlock(const aesBlock& block, vector<uint8_t>& out)
+{
+    libAES aes;
+    vector<uint8_t> last(block.bytes, block.bytes + 16);
+    aes.unpadBinary(last);
+    out.insert(out.end(), last.begin(), last.end());
+}
+
+
+void aesECBContext::init(const vector<uint8_t>& key, int enc_dec)
+{
+    libAES aes;
+    init(aes.expandKey(key), enc_dec);
+}
+
+
+void aesECBContext::init(const aesKeySchedule& schedule, int enc_dec)
+{
+    this->schedule = schedule;
+    encDec = enc_dec;
+    buffered = 0;
+    ready = true;
+}
+
+
+void aesECBContext::update(const uint8_t* in, size_t length, vector<uint8_t>& out)
+{
+    if(!ready)
+        throw runtime_error("ECB context not initialized");
+
+    size_t blocks = gatherBlocks(buffer, buffered, in, length, out, encDec);
+    uint8_t* chunk = out.data() + out.size() - (blocks * 16);
+    if(!encDec) // encryption
+        schedule.encryptBlocks(chunk, chunk, blocks, schedule);
+    else // decryption
+        schedule.decryptBlocks(chunk, chunk, blocks, schedule);
+}
+
+
+void aesECBContext::update(const vector<uint8_t>& binaryData, vector<uint8_t>& out)
+{
+    update(binaryData.data(), binaryData.size(), out);
+}
+
+
+void aesECBContext::final(vector<uint8_t>& out)
+{
+    if(!ready)
+        throw runtime_error("ECB context not initialized");
+    ready = false;
+
+    if(!encDec) // encryption
+    {
+        padBlock(buffer, buffered);
+        schedule.encryptBlock(buffer.bytes, buffer.bytes, schedule);
+        out.insert(out.end(), buffer.bytes, buffer.bytes + 16);
+    }
+    else if(buffered != 0) // decryption, nothing at all unpads to nothing
+    {
+        if(buffered != 16)
+            throw runtime_error("Invalid data length");
+        schedule.decryptBlock(buffer.bytes, buffer.bytes, schedule);
+        unpadBlock(buffer, out);
+    }
+}
+
+
+void aesCBCContext::init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+{
+    libAES aes;
+    init(aes.expandKey(key), iv, enc_dec);
+}
+
+
+void aesCBCContext::init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    if(iv.size() != 16)
+        throw runtime_error("Invalid IV length");
+    copy(iv.begin(), iv.end(), feedback.bytes);
+
+    this->schedule = schedule;
+    encDec = enc_dec;
+    buffered = 0;
+    ready = true;
+}
+
+
+void aesCBCContext::update(const uint8_t* in, size_t length, vector<uint8_t>& out)
+{
+    if(!ready)
+        throw runtime_error("CBC context not initialized");
+
+    size_t blocks = gatherBlocks(buffer, buffered, in, length, out, encDec);
+    uint8_t* data = out.data() + out.size() - (blocks * 16);
+    if(blocks == 0)
+        return;
+
+    if(!encDec) // encryption
+    {
+        for(size_t i = 0; i < blocks; i++)
+        {
+            uint8_t* chunk = data + (i * 16);
+            libAES::addRoundKey(feedback, chunk);
+            schedule.encryptBlock(feedback.bytes, feedback.bytes, schedule);
+            copy(feedback.bytes, feedback.bytes + 16, chunk);
+        }
+    }
+    else // decryption, the last cipher block is the iv of the next call
+    {
+        aesBlock next;
+        copy(data + ((blocks - 1) * 16), data + (blocks * 16), next.bytes);
+        cbcDecryptRange(schedule, feedback, data, data, blocks);
+        feedback = next;
+    }
+}
+
+
+void aesCBCContext::update(const vector<uint8_t>& binaryData, vector<uint8_t>& out)
+{
+    update(binaryData.data(), binaryData.size(), out);
+}
+
+
+void aesCBCContext::final(vector<uint8_t>& out)
+{
+    if(!ready)
+        throw runtime_error("CBC context not initialized");
+    ready = false;
+
+    if(!encDec) // encryption
+    {
+        padBlock(buffer, buffered);
+        libAES::addRoundKey(feedback, buffer.bytes);
+        schedule.encryptBlock(feedback.bytes, feedback.bytes, schedule);
+        out.insert(out.end(), feedback.bytes, feedback.bytes + 16);
+    }
+    else if(buffered != 0) // decryption, nothing at all unpads to nothing
+    {
+        if(buffered != 16)
+            throw runtime_error("Invalid data length");
+        schedule.decryptBlock(buffer.bytes, buffer.bytes, schedule);
+        libAES::addRoundKey(buffer, feedback.bytes);
+        unpadBlock(buffer, out);
+    }
+}
+
+
+void aesCFBContext::init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+{
+    libAES aes;
+    init(aes.expandKey(key), iv, enc_dec);
+}
+
+
+void aesCFBContext::init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    if(iv.size() != 16)
+        throw runtime_error("Invalid IV length");
+    copy(iv.begin(), iv.end(), feedback.bytes);
+
+    this->schedule = schedule;
+    encDec = enc_dec;
+    position = 0;
+    ready = true;
+}
+
+
+void aesCFBContext::update(const uint8_t* in, uint8_t* out, size_t length)
+{
+    if(!ready)
+        throw runtime_error("CFB context not initialized");
+
+    size_t done = 0;
+    while(done < length)
+    {
+        // decryption of whole blocks has all its cipher inputs up front
+        if(encDec && position == 0 && length - done >= 16)
+        {
+            size_t blocks = (length - done) / 16;
+            aesBlock next;
+            copy(in + done + ((blocks - 1) * 16), in + done + (blocks * 16), next.bytes);
+            cfbDecryptRange(schedule, feedback, in + done, out + done, blocks * 16);
+            feedback = next;
+            done += blocks * 16;
+            continue;
+        }
+
+        // one keystream block, the cipher bytes replace its input as they come
+        if(position == 0)
+            schedule.encryptBlock(feedback.bytes, keystream.bytes, schedule);
+        size_t take = min(16 - position, length - done);
+        for(size_t j = 0; j < take; j++)
+        {
+            uint8_t text = in[done + j];
+            out[done + j] = text ^ keystream[position + j];
+            feedback[position + j] = encDec ? text : out[done + j];
+        }
+        position = (position + take) % 16;
+        done += take;
+    }
+}
+
+
+void aesCFBContext::update(vector<uint8_t>& binaryData)
+{
+    update(binaryData.data(), binaryData.data(), binaryData.size());
+}
+
+
+void aesCFBContext::final()
+{
+    if(!ready)
+        throw runtime_error("CFB context not initialized");
+    ready = false;
+}
+
+
+void aesOFBContext::init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec)
+{
+    libAES aes;
+    init(aes.expandKey(key), iv, enc_dec);
+}
+
+
+void aesOFBContext::init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec)
+{
+    if(iv.size() != 16)
+        throw runtime_error("Invalid IV length");
+    copy(iv.begin(), iv.end(), state.bytes);
+
+    this->schedule = schedule;
+    position = 0;
+    ready = true;
+}
+
+
+// encryption and decryption are symetric
+void aesOFBContext::update(const uint8_t* in, uint8_t* out, size_t length)
+{
+    if(!ready)
+        throw runtime_error("OFB context not initialized");
+
+    for(size_t i = 0; i < length; i++)
+    {
+        if(position == 0)
+            schedule.encryptBlock(state.bytes, state.bytes, schedule);
+        out[i] = in[i] ^ state[position];
+        position = (position + 1) % 16;
+    }
+}
+
+
+void aesOFBContext::update(vector<uint8_t>& binaryData)
+{
+    update(binaryData.data(), binaryData.data(), binaryData.size());
+}
+
+
+void aesOFBContext::final()
+{
+    if(!ready)
+        throw runtime_error("OFB context not initialized");
+    ready = false;
+}
+
+
+void aesCTRContext::init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter)
+{
+    libAES aes;
+    init(aes.expandKey(key), iv, enc_dec, counter);
+}
+
+
+void aesCTRContext::init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter)
+{
+    // the block is the 12 byte iv followed by the 32 bit counter, as in aesCTR
+    if(iv.size() != 12)
+        throw runtime_error("Invalid IV length");
+    if(counter.size() != 4)
+        throw runtime_error("Invalid counter length");
+    for(size_t k = 0; k < 16; k++)
+        counterBlock[k] = (k < iv.size()) ? iv[k] : counter[k - iv.size()];
+    num = (static_cast<uint32_t>(counter[0]) << 24) | (static_cast<uint32_t>(counter[1]) << 16) | (static_cast<uint32_t>(counter[2]) << 8)  | (static_cast<uint32_t>(counter[3]));
+
+    this->schedule = schedule;
+    position = 0;
+    ready = true;
+}
+
+
+void aesCTRContext::update(const uint8_t* in, uint8_t* out, size_t length)
+{
+    if(!ready)
+        throw runtime_error("CTR context not initialized");
+
+    size_t done = 0;
+    while(done < length)
+    {
+        // whole blocks go through the same code as aesCTR
+        if(position == 0 && length - done >= 16)
+        {
+            size_t blocks = (length - done) / 16;
+            ctrRange(schedule, counterBlock, num, in + done, out + done, blocks * 16);
+            num += static_cast<uint32_t>(blocks);
+            done += blocks * 16;
+            continue;
+        }
+
+        // keystream of a short block is kept for the next call
+        if(position == 0)
+        {
+            keystream = {};
+            ctrRange(schedule, counterBlock, num, keystream.bytes, keystream.bytes, 16);
+            num++;
+        }
+        size_t take = min(16 - position, length - done);
+        for(size_t j = 0; j < take; j++)
+            out[done + j] = in[done + j] ^ keystream[position + j];
+        position = (position + take) % 16;
+        done += take;
+    }
+}
+
+
+void aesCTRContext::update(vector<uint8_t>& binaryData)
+{
+    update(binaryData.data(), binaryData.data(), binaryData.size());
+}
+
+
+void aesCTRContext::final()
+{
+    if(!ready)
+        throw runtime_error("CTR context not initialized");
+    ready = false;
+}
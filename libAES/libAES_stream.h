@@ -0,0 +1,113 @@
+#ifndef LIBAES_STREAM_H
+#define LIBAES_STREAM_H
+
+#include "libAES.h"
+
+// Contexts for the other modes, fed a message in pieces of any size in
+// constant memory. Call init, then update for each chunk, then final. They
+// give the same output as aesECB, aesCBC, aesCFB, aesOFB and aesCTR on the
+// whole message, and init starts the next one.
+
+// ECB and CBC keep a short block back between calls and PKCS#7 pad or
+// unpad in final, so they append to `out` whatever is ready: less than
+// the input while a block is held back and up to 16 bytes more in final.
+// Decryption always holds the last whole block for final to unpad.
+class aesECBContext
+{
+    public:
+        void init(const vector<uint8_t>& key, int enc_dec);
+        void init(const aesKeySchedule& schedule, int enc_dec);
+
+        void update(const uint8_t* in, size_t length, vector<uint8_t>& out);
+        void update(const vector<uint8_t>& binaryData, vector<uint8_t>& out);
+        void final(vector<uint8_t>& out);
+
+    private:
+        aesKeySchedule schedule;
+        int encDec = 0;
+        aesBlock buffer;
+        size_t buffered = 0;
+        bool ready = false;
+};
+
+
+class aesCBCContext
+{
+    public:
+        void init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+
+        void update(const uint8_t* in, size_t length, vector<uint8_t>& out);
+        void update(const vector<uint8_t>& binaryData, vector<uint8_t>& out);
+        void final(vector<uint8_t>& out);
+
+    private:
+        aesKeySchedule schedule;
+        int encDec = 0;
+        aesBlock feedback; // last cipher block
+        aesBlock buffer;
+        size_t buffered = 0;
+        bool ready = false;
+};
+
+
+// CFB, OFB and CTR need no padding, so update en/decrypts exactly length
+// bytes from in to out (in may equal out) and final only ends the message.
+class aesCFBContext
+{
+    public:
+        void init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+
+        void update(const uint8_t* in, uint8_t* out, size_t length);
+        void update(vector<uint8_t>& binaryData);
+        void final();
+
+    private:
+        aesKeySchedule schedule;
+        int encDec = 0;
+        aesBlock feedback; // cipher block so far, input of the next keystream
+        aesBlock keystream;
+        size_t position = 0; // bytes of keystream used, 0 when a new block is due
+        bool ready = false;
+};
+
+
+class aesOFBContext
+{
+    public:
+        void init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec);
+        void init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec);
+
+        void update(const uint8_t* in, uint8_t* out, size_t length);
+        void update(vector<uint8_t>& binaryData);
+        void final();
+
+    private:
+        aesKeySchedule schedule;
+        aesBlock state; // last keystream block
+        size_t position = 0;
+        bool ready = false;
+};
+
+
+class aesCTRContext
+{
+    public:
+        void init(const vector<uint8_t>& key, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter = {0, 0, 0, 0});
+        void init(const aesKeySchedule& schedule, const vector<uint8_t>& iv, int enc_dec, const vector<uint8_t>& counter = {0, 0, 0, 0});
+
+        void update(const uint8_t* in, uint8_t* out, size_t length);
+        void update(vector<uint8_t>& binaryData);
+        void final();
+
+    private:
+        aesKeySchedule schedule;
+        aesBlock counterBlock; // 12 byte iv followed by the counter
+        uint32_t num = 0; // counter of the next keystream block
+        aesBlock keystream;
+        size_t position = 0;
+        bool ready = false;
+};
+
+#endif
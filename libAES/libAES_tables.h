@@ -0,0 +1,115 @@
+#ifndef LIBAES_TABLES_H
+#define LIBAES_TABLES_H
+
+#include <stdint.h>
+
+// Lookup tables shared by every libAES instance and backend. They are
+// generated by the compiler from the field arithmetic, so there is nothing
+// to build or copy at runtime.
+
+// multiply by x in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1
+constexpr uint8_t aesXtime(uint8_t data)
+{
+    return static_cast<uint8_t>((data << 1) ^ ((data & 0x80) ? 0x1b : 0x00));
+}
+
+
+constexpr uint8_t aesRotl8(uint8_t data, int shift)
+{
+    return static_cast<uint8_t>((data << shift) | (data >> (8 - shift)));
+}
+
+
+constexpr uint32_t aesRotr32(uint32_t word)
+{
+    return (word >> 8) | (word << 24);
+}
+
+
+struct aesTables
+{
+    alignas(16) uint8_t sbox[256];
+    alignas(16) uint8_t sboxInv[256];
+
+    // products used by MixColumns and InvMixColumns
+    uint8_t mul2[256];
+    uint8_t mul3[256];
+    uint8_t mul9[256];
+    uint8_t mul11[256];
+    uint8_t mul13[256];
+    uint8_t mul14[256];
+
+    // SubBytes and (Inv)MixColumns of one byte as a big endian column word,
+    // rotated one byte further for each row
+    uint32_t Te[4][256];
+    uint32_t Td[4][256];
+
+    uint8_t rcon[10];
+
+    constexpr aesTables() : sbox(), sboxInv(), mul2(), mul3(), mul9(), mul11(), mul13(), mul14(), Te(), Td(), rcon()
+    {
+        // walk the multiplicative group with generator 3, q stays the inverse of p
+        uint8_t p = 1;
+        uint8_t q = 1;
+        do
+        {
+            p = p ^ aesXtime(p);
+
+            q ^= static_cast<uint8_t>(q << 1);
+            q ^= static_cast<uint8_t>(q << 2);
+            q ^= static_cast<uint8_t>(q << 4);
+            if(q & 0x80)
+                q ^= 0x09;
+
+            // affine transformation of the inverse
+            sbox[p] = q ^ aesRotl8(q, 1) ^ aesRotl8(q, 2) ^ aesRotl8(q, 3) ^ aesRotl8(q, 4) ^ 0x63;
+        } while(p != 1);
+        sbox[0] = 0x63; // 0 has no inverse
+
+        for(int i = 0; i < 256; i++)
+        {
+            uint8_t x = static_cast<uint8_t>(i);
+            uint8_t x2 = aesXtime(x);
+            uint8_t x4 = aesXtime(x2);
+            uint8_t x8 = aesXtime(x4);
+
+            sboxInv[sbox[i]] = x;
+            mul2[i] = x2;
+            mul3[i] = x2 ^ x;
+            mul9[i] = x8 ^ x;
+            mul11[i] = x8 ^ x2 ^ x;
+            mul13[i] = x8 ^ x4 ^ x;
+            mul14[i] = x8 ^ x4 ^ x2;
+        }
+
+        for(int i = 0; i < 256; i++)
+        {
+            uint32_t s = sbox[i];
+            uint32_t si = sboxInv[i];
+            Te[0][i] = (static_cast<uint32_t>(mul2[s]) << 24) | (s << 16) | (s << 8) | mul3[s];
+            Td[0][i] = (static_cast<uint32_t>(mul14[si]) << 24) | (static_cast<uint32_t>(mul9[si]) << 16) | (static_cast<uint32_t>(mul13[si]) << 8) | mul11[si];
+
+            for(int j = 1; j < 4; j++)
+            {
+                Te[j][i] = aesRotr32(Te[j - 1][i]);
+                Td[j][i] = aesRotr32(Td[j - 1][i]);
+            }
+        }
+
+        uint8_t r = 1;
+        for(int i = 0; i < 10; i++)
+        {
+            rcon[i] = r;
+            r = aesXtime(r);
+        }
+    }
+};
+
+inline constexpr aesTables AES_TABLES;
+
+// spot checks against FIPS-197
+static_assert(AES_TABLES.sbox[0x00] == 0x63 && AES_TABLES.sbox[0x53] == 0xed && AES_TABLES.sbox[0xff] == 0x16, "bad S-box");
+static_assert(AES_TABLES.sboxInv[0x63] == 0x00 && AES_TABLES.sboxInv[0x00] == 0x52, "bad inverse S-box");
+static_assert(AES_TABLES.rcon[8] == 0x1b && AES_TABLES.rcon[9] == 0x36, "bad Rcon");
+
+#endif
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "libAES_threads.h"
+
+using namespace std;
+
+// Workers are started on first use and kept until exit, so a parallel call
+// costs a wake up instead of creating threads. One job runs at a time; its
+// tasks are handed out one by one to whichever thread asks next.
+class threadPool
+{
+    public:
+        ~threadPool()
+        {
+            {
+                lock_guard<mutex> guard(stateLock);
+                stopping = true;
+            }
+            wake.notify_all();
+            for(thread& worker : workers)
+                worker.join();
+        }
+
+        void run(size_t tasks, const function<void(size_t)>& task)
+        {
+            lock_guard<mutex> oneJob(jobLock);
+            unique_lock<mutex> guard(stateLock);
+
+            // the caller works too, so one worker fewer than tasks is enough
+            while(workers.size() + 1 < tasks)
+                workers.emplace_back(&threadPool::work, this, generation);
+
+            job = &task;
+            nextTask = 0;
+            taskCount = tasks;
+            pending = tasks;
+            generation++;
+            wake.notify_all();
+
+            runTasks(guard);
+            finished.wait(guard, [this] { return pending == 0; });
+            job = nullptr;
+        }
+
+    private:
+        void work(unsigned seen)
+        {
+            unique_lock<mutex> guard(stateLock);
+            while(true)
+            {
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if(stopping)
+                    return;
+                seen = generation;
+                runTasks(guard);
+            }
+        }
+
+        // called with stateLock held, released while a task runs
+        void runTasks(unique_lock<mutex>& guard)
+        {
+            while(nextTask < taskCount)
+            {
+                size_t index = nextTask++;
+                const function<void(size_t)>& task = *job;
+
+                guard.unlock();
+                task(index);
+                guard.lock();
+
+                if(--pending == 0)
+                    finished.notify_all();
+            }
+        }
+
+        vector<thread> workers;
+        mutex jobLock;
+        mutex stateLock;
+        condition_variable wake;
+        condition_variable finished;
+        const function<void(size_t)>* job = nullptr;
+        size_t nextTask = 0;
+        size_t taskCount = 0;
+        size_t pending = 0;
+        unsigned generation = 0;
+        bool stopping = false;
+};
+
+
+unsigned parallelThreads(unsigned threads, size_t blocks)
+{
+    if(threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+
+    size_t limit = max<size_t>(1, blocks / PARALLEL_MIN_BLOCKS);
+    return static_cast<unsigned>(min<size_t>(threads, limit));
+}
+
+
+void parallelFor(size_t tasks, const function<void(size_t)>& task)
+{
+    if(tasks == 1)
+    {
+        task(0);
+        return;
+    }
+
+    static threadPool pool;
+    pool.run(tasks, task);
+}
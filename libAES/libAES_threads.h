@@ -0,0 +1,20 @@
+#ifndef LIBAES_THREADS_H
+#define LIBAES_THREADS_H
+
+#include <stddef.h>
+#include <functional>
+
+// Smallest share of a job worth handing to another thread, 64 KiB of data.
+// Below this the wake up costs more than the blocks.
+static const size_t PARALLEL_MIN_BLOCKS = 4096;
+
+// Number of threads to split `blocks` blocks over: at most `threads` (0 is
+// one per hardware thread) and at least PARALLEL_MIN_BLOCKS blocks each.
+unsigned parallelThreads(unsigned threads, size_t blocks);
+
+// Runs task(0) .. task(tasks - 1) on a pool of worker threads and the
+// calling thread, and returns once all of them are done. Tasks must not
+// throw.
+void parallelFor(size_t tasks, const std::function<void(size_t)>& task);
+
+#endif
@@ -0,0 +1,210 @@
+#include <stdint.h>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+using namespace std;
+
+// Word oriented AES. SubBytes, ShiftRows and MixColumns of one column are
+// fused into four 32 bit table lookups. State words are big endian columns,
+// so the first byte of a column is the most significant byte of its word.
+
+static const aesTables& T = AES_TABLES;
+
+
+static uint32_t loadWord(const uint8_t* bytes)
+{
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+}
+
+
+static void storeWord(uint8_t* bytes, uint32_t word)
+{
+    bytes[0] = word >> 24;
+    bytes[1] = word >> 16;
+    bytes[2] = word >> 8;
+    bytes[3] = word;
+}
+
+
+template<int Rounds>
+void ttableEncrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    const uint8_t* rk = schedule.roundKeys;
+    uint32_t s0 = loadWord(in)      ^ loadWord(rk);
+    uint32_t s1 = loadWord(in + 4)  ^ loadWord(rk + 4);
+    uint32_t s2 = loadWord(in + 8)  ^ loadWord(rk + 8);
+    uint32_t s3 = loadWord(in + 12) ^ loadWord(rk + 12);
+    uint32_t t0, t1, t2, t3;
+
+#pragma GCC unroll 14
+    for(int round = 1; round < Rounds; round++)
+    {
+        rk += 16;
+        t0 = T.Te[0][s0 >> 24] ^ T.Te[1][(s1 >> 16) & 0xff] ^ T.Te[2][(s2 >> 8) & 0xff] ^ T.Te[3][s3 & 0xff] ^ loadWord(rk);
+        t1 = T.Te[0][s1 >> 24] ^ T.Te[1][(s2 >> 16) & 0xff] ^ T.Te[2][(s3 >> 8) & 0xff] ^ T.Te[3][s0 & 0xff] ^ loadWord(rk + 4);
+        t2 = T.Te[0][s2 >> 24] ^ T.Te[1][(s3 >> 16) & 0xff] ^ T.Te[2][(s0 >> 8) & 0xff] ^ T.Te[3][s1 & 0xff] ^ loadWord(rk + 8);
+        t3 = T.Te[0][s3 >> 24] ^ T.Te[1][(s0 >> 16) & 0xff] ^ T.Te[2][(s1 >> 8) & 0xff] ^ T.Te[3][s2 & 0xff] ^ loadWord(rk + 12);
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    // last round has no MixColumns
+    rk += 16;
+    t0 = (static_cast<uint32_t>(T.sbox[s0 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sbox[(s1 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sbox[(s2 >> 8) & 0xff]) << 8) ^ T.sbox[s3 & 0xff];
+    t1 = (static_cast<uint32_t>(T.sbox[s1 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sbox[(s2 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sbox[(s3 >> 8) & 0xff]) << 8) ^ T.sbox[s0 & 0xff];
+    t2 = (static_cast<uint32_t>(T.sbox[s2 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sbox[(s3 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sbox[(s0 >> 8) & 0xff]) << 8) ^ T.sbox[s1 & 0xff];
+    t3 = (static_cast<uint32_t>(T.sbox[s3 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sbox[(s0 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sbox[(s1 >> 8) & 0xff]) << 8) ^ T.sbox[s2 & 0xff];
+    storeWord(out,      t0 ^ loadWord(rk));
+    storeWord(out + 4,  t1 ^ loadWord(rk + 4));
+    storeWord(out + 8,  t2 ^ loadWord(rk + 8));
+    storeWord(out + 12, t3 ^ loadWord(rk + 12));
+}
+
+
+template<int Rounds>
+void ttableDecrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    const uint8_t* rk = schedule.decRoundKeys;
+    uint32_t s0 = loadWord(in)      ^ loadWord(rk);
+    uint32_t s1 = loadWord(in + 4)  ^ loadWord(rk + 4);
+    uint32_t s2 = loadWord(in + 8)  ^ loadWord(rk + 8);
+    uint32_t s3 = loadWord(in + 12) ^ loadWord(rk + 12);
+    uint32_t t0, t1, t2, t3;
+
+    // Td folds InvMixColumns into the lookup, the decryption round keys
+    // already had InvMixColumns applied by expandKey
+#pragma GCC unroll 14
+    for(int round = 1; round < Rounds; round++)
+    {
+        rk += 16;
+        t0 = T.Td[0][s0 >> 24] ^ T.Td[1][(s3 >> 16) & 0xff] ^ T.Td[2][(s2 >> 8) & 0xff] ^ T.Td[3][s1 & 0xff] ^ loadWord(rk);
+        t1 = T.Td[0][s1 >> 24] ^ T.Td[1][(s0 >> 16) & 0xff] ^ T.Td[2][(s3 >> 8) & 0xff] ^ T.Td[3][s2 & 0xff] ^ loadWord(rk + 4);
+        t2 = T.Td[0][s2 >> 24] ^ T.Td[1][(s1 >> 16) & 0xff] ^ T.Td[2][(s0 >> 8) & 0xff] ^ T.Td[3][s3 & 0xff] ^ loadWord(rk + 8);
+        t3 = T.Td[0][s3 >> 24] ^ T.Td[1][(s2 >> 16) & 0xff] ^ T.Td[2][(s1 >> 8) & 0xff] ^ T.Td[3][s0 & 0xff] ^ loadWord(rk + 12);
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    // last round has no InvMixColumns
+    rk += 16;
+    t0 = (static_cast<uint32_t>(T.sboxInv[s0 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sboxInv[(s3 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sboxInv[(s2 >> 8) & 0xff]) << 8) ^ T.sboxInv[s1 & 0xff];
+    t1 = (static_cast<uint32_t>(T.sboxInv[s1 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sboxInv[(s0 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sboxInv[(s3 >> 8) & 0xff]) << 8) ^ T.sboxInv[s2 & 0xff];
+    t2 = (static_cast<uint32_t>(T.sboxInv[s2 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sboxInv[(s1 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sboxInv[(s0 >> 8) & 0xff]) << 8) ^ T.sboxInv[s3 & 0xff];
+    t3 = (static_cast<uint32_t>(T.sboxInv[s3 >> 24]) << 24) ^ (static_cast<uint32_t>(T.sboxInv[(s2 >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sboxInv[(s1 >> 8) & 0xff]) << 8) ^ T.sboxInv[s0 & 0xff];
+    storeWord(out,      t0 ^ loadWord(rk));
+    storeWord(out + 4,  t1 ^ loadWord(rk + 4));
+    storeWord(out + 8,  t2 ^ loadWord(rk + 8));
+    storeWord(out + 12, t3 ^ loadWord(rk + 12));
+}
+
+template void ttableEncrypt<10>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template void ttableEncrypt<12>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template void ttableEncrypt<14>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template void ttableDecrypt<10>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template void ttableDecrypt<12>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template void ttableDecrypt<14>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+
+
+// Four independent blocks per pass, interleaved round by round. One block
+// is a chain of dependent table loads, four of them keep more loads in
+// flight. Lane b of the state is s[b][0..3]; every loop over lanes and
+// columns is unrolled so the state stays in registers.
+template<int Rounds>
+void ttableEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    uint32_t s[4][4];
+    uint32_t t[4][4];
+
+    for(; blocks >= 4; blocks -= 4, in += 64, out += 64)
+    {
+        const uint8_t* rk = schedule.roundKeys;
+#pragma GCC unroll 4
+        for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+            for(int c = 0; c < 4; c++)
+                s[b][c] = loadWord(in + (b * 16) + (c * 4)) ^ loadWord(rk + (c * 4));
+
+#pragma GCC unroll 14
+        for(int round = 1; round < Rounds; round++)
+        {
+            rk += 16;
+#pragma GCC unroll 4
+            for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+                for(int c = 0; c < 4; c++)
+                    t[b][c] = T.Te[0][s[b][c] >> 24] ^ T.Te[1][(s[b][(c + 1) & 3] >> 16) & 0xff] ^ T.Te[2][(s[b][(c + 2) & 3] >> 8) & 0xff] ^ T.Te[3][s[b][(c + 3) & 3] & 0xff] ^ loadWord(rk + (c * 4));
+#pragma GCC unroll 4
+            for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+                for(int c = 0; c < 4; c++)
+                    s[b][c] = t[b][c];
+        }
+
+        // last round has no MixColumns
+        rk += 16;
+#pragma GCC unroll 4
+        for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+            for(int c = 0; c < 4; c++)
+                storeWord(out + (b * 16) + (c * 4), ((static_cast<uint32_t>(T.sbox[s[b][c] >> 24]) << 24) ^ (static_cast<uint32_t>(T.sbox[(s[b][(c + 1) & 3] >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sbox[(s[b][(c + 2) & 3] >> 8) & 0xff]) << 8) ^ T.sbox[s[b][(c + 3) & 3] & 0xff]) ^ loadWord(rk + (c * 4)));
+    }
+
+    for(; blocks > 0; blocks--, in += 16, out += 16)
+        ttableEncrypt<Rounds>(in, out, schedule);
+}
+
+
+template<int Rounds>
+void ttableDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    uint32_t s[4][4];
+    uint32_t t[4][4];
+
+    for(; blocks >= 4; blocks -= 4, in += 64, out += 64)
+    {
+        const uint8_t* rk = schedule.decRoundKeys;
+#pragma GCC unroll 4
+        for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+            for(int c = 0; c < 4; c++)
+                s[b][c] = loadWord(in + (b * 16) + (c * 4)) ^ loadWord(rk + (c * 4));
+
+#pragma GCC unroll 14
+        for(int round = 1; round < Rounds; round++)
+        {
+            rk += 16;
+#pragma GCC unroll 4
+            for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+                for(int c = 0; c < 4; c++)
+                    t[b][c] = T.Td[0][s[b][c] >> 24] ^ T.Td[1][(s[b][(c + 3) & 3] >> 16) & 0xff] ^ T.Td[2][(s[b][(c + 2) & 3] >> 8) & 0xff] ^ T.Td[3][s[b][(c + 1) & 3] & 0xff] ^ loadWord(rk + (c * 4));
+#pragma GCC unroll 4
+            for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+                for(int c = 0; c < 4; c++)
+                    s[b][c] = t[b][c];
+        }
+
+        // last round has no InvMixColumns
+        rk += 16;
+#pragma GCC unroll 4
+        for(int b = 0; b < 4; b++)
+#pragma GCC unroll 4
+            for(int c = 0; c < 4; c++)
+                storeWord(out + (b * 16) + (c * 4), ((static_cast<uint32_t>(T.sboxInv[s[b][c] >> 24]) << 24) ^ (static_cast<uint32_t>(T.sboxInv[(s[b][(c + 3) & 3] >> 16) & 0xff]) << 16) ^ (static_cast<uint32_t>(T.sboxInv[(s[b][(c + 2) & 3] >> 8) & 0xff]) << 8) ^ T.sboxInv[s[b][(c + 1) & 3] & 0xff]) ^ loadWord(rk + (c * 4)));
+    }
+
+    for(; blocks > 0; blocks--, in += 16, out += 16)
+        ttableDecrypt<Rounds>(in, out, schedule);
+}
+
+template void ttableEncryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void ttableEncryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void ttableEncryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void ttableDecryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void ttableDecryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void ttableDecryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+#ifdef LIBAES_X86
+#include <immintrin.h>
+
+// VAES backend for runs of independent blocks. Each round instruction works
+// on two (ymm) or four (zmm) blocks, and four registers are kept in flight
+// to cover the AESENC latency. It shares the AES-NI key schedule and leaves
+// short tails to aesniEncrypt/aesniDecrypt.
+
+#define VAES512_TARGET __attribute__((target("vaes,avx512f")))
+#define VAES256_TARGET __attribute__((target("vaes,avx2")))
+
+
+template<int Rounds, bool Decrypt>
+VAES512_TARGET static void vaes512Blocks(const uint8_t* in, uint8_t* out, size_t blocks, const uint8_t* keys)
+{
+    __m512i rk[15];
+    for(int i = 0; i <= Rounds; i++)
+        rk[i] = _mm512_maskz_broadcast_i32x4(0xffff, _mm_load_si128(reinterpret_cast<const __m128i*>(keys + (i * 16))));
+
+    // 16 blocks per pass
+    for(; blocks >= 16; blocks -= 16, in += 256, out += 256)
+    {
+        __m512i b0 = _mm512_xor_si512(_mm512_loadu_si512(in),       rk[0]);
+        __m512i b1 = _mm512_xor_si512(_mm512_loadu_si512(in + 64),  rk[0]);
+        __m512i b2 = _mm512_xor_si512(_mm512_loadu_si512(in + 128), rk[0]);
+        __m512i b3 = _mm512_xor_si512(_mm512_loadu_si512(in + 192), rk[0]);
+
+        if(!Decrypt)
+        {
+#pragma GCC unroll 14
+            for(int i = 1; i < Rounds; i++)
+            {
+                b0 = _mm512_aesenc_epi128(b0, rk[i]);
+                b1 = _mm512_aesenc_epi128(b1, rk[i]);
+                b2 = _mm512_aesenc_epi128(b2, rk[i]);
+                b3 = _mm512_aesenc_epi128(b3, rk[i]);
+            }
+            b0 = _mm512_aesenclast_epi128(b0, rk[Rounds]);
+            b1 = _mm512_aesenclast_epi128(b1, rk[Rounds]);
+            b2 = _mm512_aesenclast_epi128(b2, rk[Rounds]);
+            b3 = _mm512_aesenclast_epi128(b3, rk[Rounds]);
+        }
+        else
+        {
+#pragma GCC unroll 14
+            for(int i = 1; i < Rounds; i++)
+            {
+                b0 = _mm512_aesdec_epi128(b0, rk[i]);
+                b1 = _mm512_aesdec_epi128(b1, rk[i]);
+                b2 = _mm512_aesdec_epi128(b2, rk[i]);
+                b3 = _mm512_aesdec_epi128(b3, rk[i]);
+            }
+            b0 = _mm512_aesdeclast_epi128(b0, rk[Rounds]);
+            b1 = _mm512_aesdeclast_epi128(b1, rk[Rounds]);
+            b2 = _mm512_aesdeclast_epi128(b2, rk[Rounds]);
+            b3 = _mm512_aesdeclast_epi128(b3, rk[Rounds]);
+        }
+
+        _mm512_storeu_si512(out,       b0);
+        _mm512_storeu_si512(out + 64,  b1);
+        _mm512_storeu_si512(out + 128, b2);
+        _mm512_storeu_si512(out + 192, b3);
+    }
+
+    // 4 blocks per pass
+    for(; blocks >= 4; blocks -= 4, in += 64, out += 64)
+    {
+        __m512i b0 = _mm512_xor_si512(_mm512_loadu_si512(in), rk[0]);
+#pragma GCC unroll 14
+        for(int i = 1; i < Rounds; i++)
+            b0 = Decrypt ? _mm512_aesdec_epi128(b0, rk[i]) : _mm512_aesenc_epi128(b0, rk[i]);
+        b0 = Decrypt ? _mm512_aesdeclast_epi128(b0, rk[Rounds]) : _mm512_aesenclast_epi128(b0, rk[Rounds]);
+        _mm512_storeu_si512(out, b0);
+    }
+}
+
+
+template<int Rounds, bool Decrypt>
+VAES256_TARGET static void vaes256Blocks(const uint8_t* in, uint8_t* out, size_t blocks, const uint8_t* keys)
+{
+    __m256i rk[15];
+    for(int i = 0; i <= Rounds; i++)
+        rk[i] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(keys + (i * 16))));
+
+    // 8 blocks per pass
+    for(; blocks >= 8; blocks -= 8, in += 128, out += 128)
+    {
+        __m256i b0 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)),      rk[0]);
+        __m256i b1 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32)), rk[0]);
+        __m256i b2 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 64)), rk[0]);
+        __m256i b3 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 96)), rk[0]);
+
+        if(!Decrypt)
+        {
+#pragma GCC unroll 14
+            for(int i = 1; i < Rounds; i++)
+            {
+                b0 = _mm256_aesenc_epi128(b0, rk[i]);
+                b1 = _mm256_aesenc_epi128(b1, rk[i]);
+                b2 = _mm256_aesenc_epi128(b2, rk[i]);
+                b3 = _mm256_aesenc_epi128(b3, rk[i]);
+            }
+            b0 = _mm256_aesenclast_epi128(b0, rk[Rounds]);
+            b1 = _mm256_aesenclast_epi128(b1, rk[Rounds]);
+            b2 = _mm256_aesenclast_epi128(b2, rk[Rounds]);
+            b3 = _mm256_aesenclast_epi128(b3, rk[Rounds]);
+        }
+        else
+        {
+#pragma GCC unroll 14
+            for(int i = 1; i < Rounds; i++)
+            {
+                b0 = _mm256_aesdec_epi128(b0, rk[i]);
+                b1 = _mm256_aesdec_epi128(b1, rk[i]);
+                b2 = _mm256_aesdec_epi128(b2, rk[i]);
+                b3 = _mm256_aesdec_epi128(b3, rk[i]);
+            }
+            b0 = _mm256_aesdeclast_epi128(b0, rk[Rounds]);
+            b1 = _mm256_aesdeclast_epi128(b1, rk[Rounds]);
+            b2 = _mm256_aesdeclast_epi128(b2, rk[Rounds]);
+            b3 = _mm256_aesdeclast_epi128(b3, rk[Rounds]);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),      b0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), b1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 64), b2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 96), b3);
+    }
+
+    // 2 blocks per pass
+    for(; blocks >= 2; blocks -= 2, in += 32, out += 32)
+    {
+        __m256i b0 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)), rk[0]);
+#pragma GCC unroll 14
+        for(int i = 1; i < Rounds; i++)
+            b0 = Decrypt ? _mm256_aesdec_epi128(b0, rk[i]) : _mm256_aesenc_epi128(b0, rk[i]);
+        b0 = Decrypt ? _mm256_aesdeclast_epi128(b0, rk[Rounds]) : _mm256_aesenclast_epi128(b0, rk[Rounds]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), b0);
+    }
+}
+
+
+template<int Rounds, bool Decrypt>
+static void vaesBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    const uint8_t* keys = Decrypt ? schedule.decRoundKeys : schedule.roundKeys;
+    size_t wide_blocks;
+
+    if(cpuFeatures().avx512f)
+    {
+        wide_blocks = blocks & ~static_cast<size_t>(3);
+        vaes512Blocks<Rounds, Decrypt>(in, out, wide_blocks, keys);
+    }
+    else
+    {
+        wide_blocks = blocks & ~static_cast<size_t>(1);
+        vaes256Blocks<Rounds, Decrypt>(in, out, wide_blocks, keys);
+    }
+
+    for(size_t i = wide_blocks; i < blocks; i++)
+    {
+        if(Decrypt)
+            aesniDecrypt<Rounds>(in + (i * 16), out + (i * 16), schedule);
+        else
+            aesniEncrypt<Rounds>(in + (i * 16), out + (i * 16), schedule);
+    }
+}
+
+
+template<int Rounds>
+void vaesEncryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    vaesBlocks<Rounds, false>(in, out, blocks, schedule);
+}
+
+
+template<int Rounds>
+void vaesDecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule)
+{
+    vaesBlocks<Rounds, true>(in, out, blocks, schedule);
+}
+
+template void vaesEncryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void vaesEncryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void vaesEncryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void vaesDecryptBlocks<10>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void vaesDecryptBlocks<12>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+template void vaesDecryptBlocks<14>(const uint8_t* in, uint8_t* out, size_t blocks, const aesKeySchedule& schedule);
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include "libAES.h"
+#include "libAES_backends.h"
+
+#ifdef LIBAES_X86
+#include <immintrin.h>
+
+// SSSE3 vector permute backend, one block per xmm register and constant-time.
+//
+// SubBytes splits every byte into nibbles and uses pshufb as a 16 entry
+// lookup on the low nibble, once for each of the 16 rows of the S-box. The
+// high nibble then selects which row each byte keeps. All 16 rows are read
+// for every block, so the memory access pattern never depends on the data.
+// ShiftRows and the rotations inside MixColumns are byte shuffles.
+
+#define VPERM_TARGET __attribute__((target("ssse3")))
+
+static const aesTables& V = AES_TABLES;
+
+
+VPERM_TARGET static __m128i substitute(__m128i block, const uint8_t* table)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i low = _mm_and_si128(block, nibble);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(block, 4), nibble);
+    __m128i result = _mm_setzero_si128();
+
+    for(int row = 0; row < 16; row++)
+    {
+        __m128i entries = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(table + (row * 16))), low);
+        __m128i select = _mm_cmpeq_epi8(high, _mm_set1_epi8(row));
+        result = _mm_or_si128(result, _mm_and_si128(select, entries));
+    }
+    return result;
+}
+
+
+VPERM_TARGET static __m128i shiftRows(__m128i block)
+{
+    return _mm_shuffle_epi8(block, _mm_setr_epi8(0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11));
+}
+
+
+VPERM_TARGET static __m128i shiftRowsInv(__m128i block)
+{
+    return _mm_shuffle_epi8(block, _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3));
+}
+
+
+// move every byte one (rot1) or two (rot2) rows up within its column
+VPERM_TARGET static __m128i rot1(__m128i block)
+{
+    return _mm_shuffle_epi8(block, _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+}
+
+
+VPERM_TARGET static __m128i rot2(__m128i block)
+{
+    return _mm_shuffle_epi8(block, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+}
+
+
+VPERM_TARGET static __m128i xtime(__m128i block)
+{
+    __m128i carry = _mm_cmplt_epi8(block, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_add_epi8(block, block), _mm_and_si128(carry, _mm_set1_epi8(0x1b)));
+}
+
+
+VPERM_TARGET static __m128i mixColumns(__m128i block)
+{
+    // out_r = 2(a_r ^ a_r+1) ^ a_r+1 ^ a_r+2 ^ a_r+3
+    __m128i r1 = rot1(block);
+    __m128i t = _mm_xor_si128(block, r1);
+    return _mm_xor_si128(_mm_xor_si128(xtime(t), r1), rot2(t));
+}
+
+
+VPERM_TARGET static __m128i mixColumnsInv(__m128i block)
+{
+    // InvMixColumns is MixColumns after adding 4(a_r ^ a_r+2) to every byte
+    __m128i t = _mm_xor_si128(block, rot2(block));
+    return mixColumns(_mm_xor_si128(block, xtime(xtime(t))));
+}
+
+
+template<int Rounds>
+VPERM_TARGET void vpermEncrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(schedule.roundKeys);
+    __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), rk[0]);
+
+    for(int i = 1; i < Rounds; i++)
+        block = _mm_xor_si128(mixColumns(shiftRows(substitute(block, V.sbox))), rk[i]);
+
+    block = _mm_xor_si128(shiftRows(substitute(block, V.sbox)), rk[Rounds]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+}
+
+
+template<int Rounds>
+VPERM_TARGET void vpermDecrypt(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule)
+{
+    const __m128i* rk = reinterpret_cast<const __m128i*>(schedule.roundKeys);
+    __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), rk[Rounds]);
+
+    for(int i = Rounds - 1; i > 0; i--)
+        block = mixColumnsInv(_mm_xor_si128(substitute(shiftRowsInv(block), V.sboxInv), rk[i]));
+
+    block = _mm_xor_si128(substitute(shiftRowsInv(block), V.sboxInv), rk[0]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+}
+
+template VPERM_TARGET void vpermEncrypt<10>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template VPERM_TARGET void vpermEncrypt<12>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template VPERM_TARGET void vpermEncrypt<14>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template VPERM_TARGET void vpermDecrypt<10>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template VPERM_TARGET void vpermDecrypt<12>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+template VPERM_TARGET void vpermDecrypt<14>(const uint8_t* in, uint8_t* out, const aesKeySchedule& schedule);
+
+#endif
@@ -5,7 +5,11 @@
 #include <iomanip>
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
 #include "libAES.h"
+#include "libAES_stream.h"
+#include "libAES_gcm.h"
+#include "libAES_ofb.h"
 
 using namespace std;
 
@@ -14,11 +18,53 @@ string vectorToHex(const vector<uint8_t>& data);
 void writeStringToFile(const std::string& filename, const string& content);
 
 
+// -chunk N feeds the file to a streaming context N bytes at a time. CFB,
+// OFB and CTR work in place, ECB and CBC append to a new vector
+template<typename Context>
+void streamInPlace(Context& context, vector<uint8_t>& data, size_t chunk)
+{
+    for(size_t done = 0; done < data.size(); done += chunk)
+        context.update(data.data() + done, data.data() + done, min(chunk, data.size() - done));
+    context.final();
+}
+
+
+template<typename Context>
+vector<uint8_t> streamAppending(Context& context, const vector<uint8_t>& data, size_t chunk)
+{
+    vector<uint8_t> out;
+    for(size_t done = 0; done < data.size(); done += chunk)
+        context.update(data.data() + done, min(chunk, data.size() - done), out);
+    context.final(out);
+    return out;
+}
+
+
 int main(int argc, char* argv[])
 {
-    string mode = argv[1];
     libAES AES;
 
+    // -threads N, -chunk N and -ahead N may go anywhere after the mode, take
+    // them out before the mode arguments are counted
+    vector<char*> args;
+    size_t chunk = 0;
+    size_t ahead = 0;
+    for(int i = 0; i < argc; i++)
+    {
+        if(string(argv[i]) == "-threads" && i + 1 < argc)
+            AES.setThreads(stoi(argv[++i]));
+        else if(string(argv[i]) == "-chunk" && i + 1 < argc)
+            chunk = stoull(argv[++i]);
+        else if(string(argv[i]) == "-ahead" && i + 1 < argc)
+            ahead = stoull(argv[++i]);
+        else
+            args.push_back(argv[i]);
+    }
+    argc = args.size();
+    argv = args.data();
+
+    string mode = argv[1];
+
     if(mode == "ECB")
     {
         if(argc != 5)
@@ -26,7 +72,14 @@ int main(int argc, char* argv[])
         string filename = argv[2];
         vector<uint8_t> key = fromHexString(argv[3]);
         int enc_dec = stoi(argv[4]);
-        AES.aesECB(filename, key, enc_dec);
+        if(chunk > 0)
+        {
+            aesECBContext context;
+            context.init(key, enc_dec);
+            AES.binaryToFile(streamAppending(context, AES.fileToBinary(filename), chunk), filename);
+        }
+        else
+            AES.aesECB(filename, key, enc_dec);
     }
     else if(mode == "CBC")
     {
@@ -36,7 +89,14 @@ int main(int argc, char* argv[])
         vector<uint8_t> key = fromHexString(argv[3]);
         vector<uint8_t> iv = fromHexString(argv[4]);
         int enc_dec = stoi(argv[5]);
-        AES.aesCBC(filename, key, iv, enc_dec);
+        if(chunk > 0)
+        {
+            aesCBCContext context;
+            context.init(key, iv, enc_dec);
+            AES.binaryToFile(streamAppending(context, AES.fileToBinary(filename), chunk), filename);
+        }
+        else
+            AES.aesCBC(filename, key, iv, enc_dec);
     }
     else if(mode == "CFB")
     {
@@ -46,7 +106,16 @@ int main(int argc, char* argv[])
         vector<uint8_t> key = fromHexString(argv[3]);
         vector<uint8_t> iv = fromHexString(argv[4]);
         int enc_dec = stoi(argv[5]);
-        AES.aesCFB(filename, key, iv, enc_dec);
+        if(chunk > 0)
+        {
+            aesCFBContext context;
+            context.init(key, iv, enc_dec);
+            vector<uint8_t> data = AES.fileToBinary(filename);
+            streamInPlace(context, data, chunk);
+            AES.binaryToFile(data, filename);
+        }
+        else
+            AES.aesCFB(filename, key, iv, enc_dec);
     }
     else if(mode == "OFB")
     {
@@ -56,7 +125,29 @@ int main(int argc, char* argv[])
         vector<uint8_t> key = fromHexString(argv[3]);
         vector<uint8_t> iv = fromHexString(argv[4]);
         int enc_dec = stoi(argv[5]);
-        AES.aesOFB(filename, key, iv, enc_dec);
+        if(ahead > 0)
+        {
+            // keystream from a background thread into an N byte ring, used
+            // by process in chunks (or all at once) as it becomes ready
+            aesOFBKeystream keystream(AES.expandKey(key), iv, ahead);
+            keystream.start();
+            vector<uint8_t> data = AES.fileToBinary(filename);
+            size_t step = (chunk > 0) ? chunk : max<size_t>(data.size(), 1);
+            for(size_t done = 0; done < data.size(); done += step)
+                keystream.process(data.data() + done, min(step, data.size() - done));
+            keystream.stop();
+            AES.binaryToFile(data, filename);
+        }
+        else if(chunk > 0)
+        {
+            aesOFBContext context;
+            context.init(key, iv, enc_dec);
+            vector<uint8_t> data = AES.fileToBinary(filename);
+            streamInPlace(context, data, chunk);
+            AES.binaryToFile(data, filename);
+        }
+        else
+            AES.aesOFB(filename, key, iv, enc_dec);
     }
     else if(mode == "CTR")
     {
@@ -71,7 +162,30 @@ int main(int argc, char* argv[])
             counter = fromHexString(argv[6]);
         else
             counter = fromHexString("00000001");
-        AES.aesCTR(filename, key, iv, enc_dec, counter);
+        if(chunk > 0)
+        {
+            aesCTRContext context;
+            context.init(key, iv, enc_dec, counter);
+            vector<uint8_t> data = AES.fileToBinary(filename);
+            streamInPlace(context, data, chunk);
+            AES.binaryToFile(data, filename);
+        }
+        else
+            AES.aesCTR(filename, key, iv, enc_dec, counter);
+    }
+    else if(mode == "CTRSEEK")
+    {
+        if(argc < 7 || argc > 8)
+            throw runtime_error("Error: Incorrect number of arguments for CTRSEEK mode");
+        string filename = argv[2];
+        vector<uint8_t> key = fromHexString(argv[3]);
+        vector<uint8_t> counter_block = fromHexString(argv[4]);
+        uint64_t offset = stoull(argv[5]);
+        size_t length = stoull(argv[6]);
+        int counter_bits = 32;
+        if(argc == 8)
+            counter_bits = stoi(argv[7]);
+        AES.aesCTRSeek(filename, key, counter_block, offset, length, counter_bits);
     }
     else if(mode == "GCM")
     {
@@ -99,7 +213,25 @@ int main(int argc, char* argv[])
         if(counter.empty())
             counter = fromHexString("00000001");
 
-        tag = AES.aesGCM(filename, AAD, key, iv, enc_dec, tag, counter);
+        if(chunk > 0)
+        {
+            // the file is only rewritten once the tag checks out
+            aesGCMContext context;
+            context.init(key, iv, enc_dec, counter);
+            vector<uint8_t> aad = AAD.empty() ? vector<uint8_t>() : AES.fileToBinary(AAD);
+            for(size_t done = 0; done < aad.size(); done += chunk)
+                context.updateAAD(aad.data() + done, min(chunk, aad.size() - done));
+            vector<uint8_t> data = AES.fileToBinary(filename);
+            for(size_t done = 0; done < data.size(); done += chunk)
+                context.update(data.data() + done, data.data() + done, min(chunk, data.size() - done));
+            if(enc_dec)
+                context.finalVerify(tag);
+            else
+                tag = context.finalEncrypt();
+            AES.binaryToFile(data, filename);
+        }
+        else
+            tag = AES.aesGCM(filename, AAD, key, iv, enc_dec, tag, counter);
         writeStringToFile("tag", vectorToHex(tag));
     }
     else
@@ -146,4 +278,4 @@ void writeStringToFile(const std::string& filename, const string& content)
 
     file << content;
     file.close();
-}
\ No newline at end of file
+}
@@ -0,0 +1,110 @@
+#!/bin/bash
+
+# Usage: ./run_aes_stream_test.sh ./aes_binary
+#
+# Runs every mode through its streaming context with -chunk N, feeding the
+# file (and the GCM AAD) N bytes at a time, and checks the output and GCM
+# tag against the one-shot mode on the whole file. Chunk sizes below, at
+# and above a block make the contexts carry partial blocks between calls.
+# GCM decryption with a wrong tag must fail and leave the file unchanged.
+# OFB also runs with -ahead N, its keystream made by aesOFBKeystream.
+
+AES_BIN="$1"
+
+if [[ ! -x "$AES_BIN" ]] || ! command -v openssl > /dev/null; then
+  echo "Usage: $0 <aes_binary> (needs openssl on the PATH)"
+  exit 1
+fi
+
+TMP_PLAIN="plain.bin"
+TMP_INPUT="input.bin"
+TMP_CIPHER="cipher.bin"
+TMP_AAD="aad.bin"
+TMP_TAG="expected_tag"
+TMP_RESULT="result.log"
+
+rm -f "$TMP_RESULT" "$TMP_PLAIN" "$TMP_INPUT" "$TMP_CIPHER" "$TMP_AAD" "$TMP_TAG" tag
+
+# Helper: run the binary on a copy of $1, the arguments after it follow the mode
+run() {
+  local source="$1"
+  shift
+  cp "$source" "$TMP_INPUT"
+  ./"$AES_BIN" "$@"
+  if [[ $? -ne 0 ]]; then
+    echo "[CRASH] $*" >> "$TMP_RESULT"
+    return 1
+  fi
+}
+
+# Helper: compare two files and log the result
+check() {
+  if cmp -s "$2" "$3"; then
+    echo "[PASS] $1" >> "$TMP_RESULT"
+  else
+    echo "[FAIL] $1" >> "$TMP_RESULT"
+  fi
+}
+
+for KEY_BYTES in 16 24 32; do
+  BITS=$((KEY_BYTES * 8))
+  for SIZE in 0 1 16 1000 100003; do
+    KEY=$(openssl rand -hex "$KEY_BYTES")
+    IV=$(openssl rand -hex 16)
+    NONCE=$(openssl rand -hex 12)
+    head -c "$SIZE" /dev/urandom > "$TMP_PLAIN"
+
+    for MODE in ECB CBC CFB OFB CTR; do
+      case "$MODE" in
+        ECB) ARGS=("$KEY") ;;
+        CTR) ARGS=("$KEY" "$NONCE") ;;
+        *) ARGS=("$KEY" "$IV") ;;
+      esac
+
+      # the one-shot mode gives the expected output both ways
+      run "$TMP_PLAIN" "$MODE" "$TMP_INPUT" "${ARGS[@]}" 0 || continue
+      mv "$TMP_INPUT" "$TMP_CIPHER"
+
+      for CHUNK in 1 7 15 16 17 4096 65537; do
+        NAME="AES-$BITS SIZE=$SIZE CHUNK=$CHUNK"
+        run "$TMP_PLAIN" "$MODE" "$TMP_INPUT" "${ARGS[@]}" 0 -chunk "$CHUNK" && check "$MODE ENCRYPT $NAME" "$TMP_INPUT" "$TMP_CIPHER"
+        run "$TMP_CIPHER" "$MODE" "$TMP_INPUT" "${ARGS[@]}" 1 -chunk "$CHUNK" && check "$MODE DECRYPT $NAME" "$TMP_INPUT" "$TMP_PLAIN"
+      done
+    done
+
+    # OFB keystream made ahead by a background thread into rings smaller and
+    # larger than the file
+    run "$TMP_PLAIN" OFB "$TMP_INPUT" "$KEY" "$IV" 0 || continue
+    mv "$TMP_INPUT" "$TMP_CIPHER"
+    for AHEAD in 16 1000 1048576; do
+      for CHUNK in 0 7 4096; do
+        NAME="AES-$BITS SIZE=$SIZE AHEAD=$AHEAD CHUNK=$CHUNK"
+        run "$TMP_PLAIN" OFB "$TMP_INPUT" "$KEY" "$IV" 0 -ahead "$AHEAD" -chunk "$CHUNK" && check "OFB AHEAD $NAME" "$TMP_INPUT" "$TMP_CIPHER"
+      done
+    done
+
+    # GCM also checks the tag, with AAD of a different length than the data
+    head -c $((SIZE / 3 + 5)) /dev/urandom > "$TMP_AAD"
+    run "$TMP_PLAIN" GCM "$TMP_INPUT" "$KEY" "$NONCE" 0 -aad "$TMP_AAD" || continue
+    mv "$TMP_INPUT" "$TMP_CIPHER"
+    mv tag "$TMP_TAG"
+    TAG=$(cat "$TMP_TAG")
+
+    for CHUNK in 1 7 15 16 17 4096 65537; do
+      NAME="AES-$BITS SIZE=$SIZE CHUNK=$CHUNK"
+      run "$TMP_PLAIN" GCM "$TMP_INPUT" "$KEY" "$NONCE" 0 -aad "$TMP_AAD" -chunk "$CHUNK" && check "GCM ENCRYPT $NAME" "$TMP_INPUT" "$TMP_CIPHER" && check "GCM TAG $NAME" tag "$TMP_TAG"
+      run "$TMP_CIPHER" GCM "$TMP_INPUT" "$KEY" "$NONCE" 1 -aad "$TMP_AAD" -tag "$TAG" -chunk "$CHUNK" && check "GCM DECRYPT $NAME" "$TMP_INPUT" "$TMP_PLAIN"
+
+      # a wrong tag must fail and leave the file as it was
+      BAD_TAG="$(printf "%02x" $((0x${TAG:0:2} ^ 1)))${TAG:2}"
+      cp "$TMP_CIPHER" "$TMP_INPUT"
+      if ./"$AES_BIN" GCM "$TMP_INPUT" "$KEY" "$NONCE" 1 -aad "$TMP_AAD" -tag "$BAD_TAG" -chunk "$CHUNK" 2> /dev/null; then
+        echo "[FAIL] GCM BAD TAG $NAME - accepted" >> "$TMP_RESULT"
+      else
+        check "GCM BAD TAG $NAME" "$TMP_INPUT" "$TMP_CIPHER"
+      fi
+    done
+  done
+done
+
+cat "$TMP_RESULT"
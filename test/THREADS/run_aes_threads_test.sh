@@ -0,0 +1,84 @@
+#!/bin/bash
+
+# Usage: ./run_aes_threads_test.sh ./aes_binary
+#
+# Runs every mode with one and with several threads on files big enough to
+# be split (each thread takes at least 4096 blocks, 64 KiB) and checks the
+# output against openssl enc. openssl enc has no GCM, so GCM is checked
+# against its one thread run and by decrypting with the tag.
+
+AES_BIN="$1"
+
+if [[ ! -x "$AES_BIN" ]] || ! command -v openssl > /dev/null; then
+  echo "Usage: $0 <aes_binary> (needs openssl on the PATH)"
+  exit 1
+fi
+
+TMP_PLAIN="plain.bin"
+TMP_INPUT="input.bin"
+TMP_EXPECTED="expected.bin"
+TMP_GCM="expected_gcm.bin"
+TMP_TAG="expected_tag"
+TMP_RESULT="result.log"
+
+rm -f "$TMP_RESULT" "$TMP_PLAIN" "$TMP_INPUT" "$TMP_EXPECTED" "$TMP_GCM" "$TMP_TAG" tag
+
+# Helper: compare two files and log the result
+check() {
+  if cmp -s "$2" "$3"; then
+    echo "[PASS] $1" >> "$TMP_RESULT"
+  else
+    echo "[FAIL] $1" >> "$TMP_RESULT"
+  fi
+}
+
+# Helper: run the binary on a copy of $1, the arguments after it follow the mode
+run() {
+  local source="$1"
+  shift
+  cp "$source" "$TMP_INPUT"
+  ./"$AES_BIN" "$@"
+  if [[ $? -ne 0 ]]; then
+    echo "[CRASH] $*" >> "$TMP_RESULT"
+    return 1
+  fi
+}
+
+for KEY_BYTES in 16 24 32; do
+  BITS=$((KEY_BYTES * 8))
+  for SIZE in 65536 131073 300007 1048579; do
+    KEY=$(openssl rand -hex "$KEY_BYTES")
+    IV=$(openssl rand -hex 16)
+    NONCE=$(openssl rand -hex 12)
+    openssl rand -out "$TMP_PLAIN" "$SIZE"
+
+    for THREADS in 1 2 4; do
+      NAME="AES-$BITS SIZE=$SIZE THREADS=$THREADS"
+
+      openssl enc -aes-$BITS-ecb -K "$KEY" -nosalt -in "$TMP_PLAIN" -out "$TMP_EXPECTED"
+      run "$TMP_PLAIN" ECB "$TMP_INPUT" "$KEY" 0 -threads "$THREADS" && check "ECB ENCRYPT $NAME" "$TMP_INPUT" "$TMP_EXPECTED"
+      run "$TMP_EXPECTED" ECB "$TMP_INPUT" "$KEY" 1 -threads "$THREADS" && check "ECB DECRYPT $NAME" "$TMP_INPUT" "$TMP_PLAIN"
+
+      for MODE in CBC CFB OFB; do
+        CIPHER="aes-$BITS-$(echo "$MODE" | tr '[:upper:]' '[:lower:]')"
+        openssl enc -"$CIPHER" -K "$KEY" -iv "$IV" -nosalt -in "$TMP_PLAIN" -out "$TMP_EXPECTED"
+        run "$TMP_PLAIN" "$MODE" "$TMP_INPUT" "$KEY" "$IV" 0 -threads "$THREADS" && check "$MODE ENCRYPT $NAME" "$TMP_INPUT" "$TMP_EXPECTED"
+        run "$TMP_EXPECTED" "$MODE" "$TMP_INPUT" "$KEY" "$IV" 1 -threads "$THREADS" && check "$MODE DECRYPT $NAME" "$TMP_INPUT" "$TMP_PLAIN"
+      done
+
+      # a 12 byte iv and a 4 byte counter make the first counter block
+      openssl enc -aes-$BITS-ctr -K "$KEY" -iv "${NONCE}00000001" -nosalt -in "$TMP_PLAIN" -out "$TMP_EXPECTED"
+      run "$TMP_PLAIN" CTR "$TMP_INPUT" "$KEY" "$NONCE" 0 -threads "$THREADS" && check "CTR ENCRYPT $NAME" "$TMP_INPUT" "$TMP_EXPECTED"
+      run "$TMP_EXPECTED" CTR "$TMP_INPUT" "$KEY" "$NONCE" 1 -threads "$THREADS" && check "CTR DECRYPT $NAME" "$TMP_INPUT" "$TMP_PLAIN"
+
+      if [[ "$THREADS" == "1" ]]; then
+        run "$TMP_PLAIN" GCM "$TMP_INPUT" "$KEY" "$NONCE" 0 -aad "$TMP_PLAIN" && mv "$TMP_INPUT" "$TMP_GCM" && mv tag "$TMP_TAG"
+      else
+        run "$TMP_PLAIN" GCM "$TMP_INPUT" "$KEY" "$NONCE" 0 -aad "$TMP_PLAIN" -threads "$THREADS" && check "GCM ENCRYPT $NAME" "$TMP_INPUT" "$TMP_GCM" && check "GCM TAG $NAME" tag "$TMP_TAG"
+      fi
+      run "$TMP_GCM" GCM "$TMP_INPUT" "$KEY" "$NONCE" 1 -aad "$TMP_PLAIN" -tag "$(cat "$TMP_TAG")" -threads "$THREADS" && check "GCM DECRYPT $NAME" "$TMP_INPUT" "$TMP_PLAIN"
+    done
+  done
+done
+
+cat "$TMP_RESULT"